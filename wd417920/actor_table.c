@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "actor_table.h"
+#include "err.h"
+
+/// number of the segment an index falls into
+static inline int segment_of(long index) {
+    if (index < (1L << TABLE_FIRST_SEGMENT_BITS))
+        return 0;
+    return (63 - __builtin_clzl(index)) - TABLE_FIRST_SEGMENT_BITS + 1;
+}
+
+/// index of the first element of a segment
+static inline long segment_start(int segment) {
+    return segment == 0 ? 0 : 1L << (segment + TABLE_FIRST_SEGMENT_BITS - 1);
+}
+
+static inline long segment_length(int segment) {
+    return segment == 0 ? 1L << TABLE_FIRST_SEGMENT_BITS : segment_start(segment);
+}
+
+actor_table_t* actor_table_init(size_t elem_size, long limit) {
+    int i;
+    actor_table_t *t = safe_malloc(sizeof(actor_table_t));
+
+    t->elem_size = elem_size;
+    t->limit     = limit;
+    atomic_init(&t->size, 0);
+
+    for (i = 0; i < TABLE_SEGMENTS; ++i)
+        atomic_init(&t->segments[i], NULL);
+
+    return t;
+}
+
+/**
+ * Makes sure a segment is allocated. Threads reserving elements of the same
+ * new segment race to install it, the losers free their copy.
+ */
+static void ensure_segment(actor_table_t *t, int segment) {
+    void *expected = NULL;
+    size_t bytes;
+
+    if (atomic_load_explicit(&t->segments[segment], memory_order_acquire) != NULL)
+        return;
+
+    bytes = segment_length(segment) * t->elem_size;
+    void *created = safe_aligned_malloc(bytes);
+    memset(created, 0, bytes);
+
+    if (!atomic_compare_exchange_strong(&t->segments[segment], &expected, created))
+        free(created);
+}
+
+long actor_table_reserve(actor_table_t *t, long n) {
+    int segment;
+    long first = atomic_load(&t->size);
+
+    do {
+        if (first + n > t->limit)
+            return -1;
+    } while (!atomic_compare_exchange_weak(&t->size, &first, first + n));
+
+    for (segment = segment_of(first); segment <= segment_of(first + n - 1); ++segment)
+        ensure_segment(t, segment);
+
+    return first;
+}
+
+void* actor_table_get(actor_table_t *t, long index) {
+    int segment = segment_of(index);
+    char *base = atomic_load_explicit(&t->segments[segment], memory_order_acquire);
+
+    if (base == NULL)
+        return NULL;
+
+    return base + (index - segment_start(segment)) * t->elem_size;
+}
+
+long actor_table_size(actor_table_t *t) {
+    return atomic_load(&t->size);
+}
+
+void actor_table_destroy(actor_table_t *t) {
+    int i;
+
+    for (i = 0; i < TABLE_SEGMENTS; ++i)
+        free(atomic_load(&t->segments[i]));
+
+    free(t);
+}
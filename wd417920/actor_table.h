@@ -0,0 +1,40 @@
+#ifndef ACTOR_TABLE_H
+#define ACTOR_TABLE_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define TABLE_FIRST_SEGMENT_BITS 6      ///< the first segment holds 64 elements
+#define TABLE_SEGMENTS 48               ///< segment k > 0 holds 64 << (k - 1) elements
+
+/**
+ * A table of fixed size elements indexed by actor ids. It grows by adding segments
+ * twice as big as the previous one, so elements never move: lookups are wait-free
+ * and do not have to be synchronised with reservations.
+ */
+typedef struct actor_table {
+    size_t elem_size;                           ///< size of a single element
+    long limit;                                 ///< maximal number of elements
+    atomic_long size;                           ///< number of reserved elements
+    void* _Atomic segments[TABLE_SEGMENTS];     ///< lazily allocated, zeroed segments
+} actor_table_t;
+
+extern actor_table_t* actor_table_init(size_t elem_size, long limit);
+
+/**
+ * Reserves n consecutive elements, allocating the segments they live in.
+ * @return      index of the first reserved element, -1 if the limit would be exceeded
+ */
+extern long actor_table_reserve(actor_table_t *t, long n);
+
+/**
+ * Wait-free lookup.
+ * @return      pointer to the element, NULL if its segment has not been allocated yet
+ */
+extern void* actor_table_get(actor_table_t *t, long index);
+
+extern long actor_table_size(actor_table_t *t);
+
+extern void actor_table_destroy(actor_table_t *t);
+
+#endif //ACTOR_TABLE_H
@@ -0,0 +1,107 @@
+// Scheduler throughput with independent actors.
+// The first actor spawns n actors, each of them sends m messages to itself,
+// one at a time, so every message passes through the run queues once.
+//
+// The run is repeated for 1, 2, 4, ... workers up to the given maximum.
+//
+// usage: bench_scaling [n actors] [m messages per actor] [max workers]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "err.h"
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_PING (message_type_t)0x1
+
+static long n_actors = 64;
+static long n_messages = 100000;
+
+static role_t worker_role;
+
+static void send_or_die(actor_id_t actor, message_t message) {
+    int err;
+    if ((err = send_message(actor, message)) != 0)
+        fatal("send_message failed (%d)", err);
+}
+
+static void callback_first_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    long i;
+
+    for (i = 0; i < n_actors; ++i)
+        send_or_die(actor_id_self(), (message_t) { .message_type = MSG_SPAWN, .data = &worker_role });
+
+    send_or_die(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static void callback_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    *stateptr = (void*) 0; // number of pings received so far
+    send_or_die(actor_id_self(), (message_t) { .message_type = MSG_PING });
+}
+
+static void callback_ping(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    long received = (long) *stateptr + 1;
+    *stateptr = (void*) received;
+
+    if (received < n_messages)
+        send_or_die(actor_id_self(), (message_t) { .message_type = MSG_PING });
+    else
+        send_or_die(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static void run(int n_workers, role_t *first_role) {
+    struct timespec start, end;
+    actor_id_t first_actor;
+    idle_stats_t idle;
+    actor_system_config_t config = { .n_workers = n_workers };
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (actor_system_create_ex(&first_actor, first_role, &config) != 0)
+        fatal("actor_system_create failed");
+    actor_system_join(first_actor);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    long total = n_actors * n_messages;
+
+    actor_system_idle_stats(&idle);
+
+    printf("workers=%d actors=%ld messages=%ld seconds=%.6f msgs_per_sec=%.0f"
+           " spin_budget=%ld spin_hits=%ld parks=%ld\n",
+           n_workers, n_actors, total, seconds, total / seconds,
+           idle.spin_budget / idle.workers, idle.spin_hits, idle.parks);
+}
+
+int main(int argc, char *argv[]) {
+    int workers, max_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (argc > 1) n_actors = atol(argv[1]);
+    if (argc > 2) n_messages = atol(argv[2]);
+    if (argc > 3) max_workers = atoi(argv[3]);
+
+    act_t first_actions[] = { callback_first_hello };
+    act_t actions[] = { callback_hello, callback_ping };
+
+    role_t first_role = { .nprompts = 1, .prompts = first_actions };
+    worker_role = (role_t) { .nprompts = 2, .prompts = actions };
+
+    for (workers = 1; workers <= max_workers; workers *= 2)
+        run(workers, &first_role);
+
+    return 0;
+}
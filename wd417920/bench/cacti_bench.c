@@ -0,0 +1,559 @@
+// Benchmark suite of the runtime, one line of key=value pairs per workload:
+//
+//   pingpong   two actors send a message back and forth, latency of a round trip
+//   fanout     one actor sends to n actors and waits for all their replies, latency of a round
+//   chain      every actor spawns the next one and hands its state over, as silnia does,
+//              latency of a hop
+//   ring       tokens travel around a ring of actors, as rows of macierz travel through
+//              its columns, latency of a lap
+//   queue      producer threads push into a queue_t drained by one thread, latency of a message
+//   bqueue     producer threads push into a blocking_queue_t drained by consumer threads
+//
+// Every line has msgs_per_sec and percentiles of the workload's latency in nanoseconds.
+//
+// usage: cacti_bench [-w workers] [-s scale] [workload ...]
+//        scale multiplies the number of messages of every workload, all of them run if none is named
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "cacti.h"
+#include "err.h"
+#include "queue.h"
+#include "blocking_queue.h"
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_PING (message_type_t)0x1
+#define MSG_PONG (message_type_t)0x2
+
+#define MSG_READY (message_type_t)0x1   ///< chain: a child tells its parent its id
+#define MSG_STATE (message_type_t)0x2   ///< chain: the parent hands the hop count over
+
+#define QUEUE_SAMPLE 64                 ///< queue workloads time every this many messages
+
+static int n_workers;
+static double scale = 1.0;
+
+static long *samples;                   ///< latencies of the running workload, in nanoseconds
+static long n_samples;
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static long scaled(long n) {
+    long res = (long) (n * scale);
+    return res > 0 ? res : 1;
+}
+
+static void send_or_die(actor_id_t actor, message_t message) {
+    int err;
+    if ((err = send_message(actor, message)) != 0)
+        fatal("send_message failed (%d)", err);
+}
+
+static void die() {
+    send_or_die(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static void start_samples(long n) {
+    samples   = malloc(n * sizeof(long));
+    n_samples = 0;
+    if (samples == NULL)
+        fatal("Out of memory (%ld samples)", n);
+}
+
+static int compare_longs(const void *a, const void *b) {
+    long x = *(const long*) a, y = *(const long*) b;
+    return (x > y) - (x < y);
+}
+
+static long percentile(double q) {
+    return n_samples > 0 ? samples[(long) (q * (n_samples - 1))] : 0;
+}
+
+/// prints a line of results and frees the samples
+static void report(const char *name, const char *params, long messages, long ns) {
+    qsort(samples, n_samples, sizeof(long), compare_longs);
+
+    printf("bench=%s workers=%d %s messages=%ld seconds=%.6f msgs_per_sec=%.0f"
+           " samples=%ld p50_ns=%ld p99_ns=%ld p999_ns=%ld max_ns=%ld\n",
+           name, n_workers, params, messages, ns / 1e9, messages / (ns / 1e9),
+           n_samples, percentile(0.5), percentile(0.99), percentile(0.999),
+           n_samples > 0 ? samples[n_samples - 1] : 0);
+    fflush(stdout);
+
+    free(samples);
+}
+
+/// runs a system until all its actors are dead
+static long run_system(role_t *first_role) {
+    actor_id_t first_actor;
+    actor_system_config_t config = { .n_workers = n_workers };
+    long start = now_ns();
+
+    if (actor_system_create_ex(&first_actor, first_role, &config) != 0)
+        fatal("actor_system_create failed");
+    actor_system_join(first_actor);
+
+    return now_ns() - start;
+}
+
+// pingpong
+
+static long pp_rounds;
+static role_t pp_ponger_role;
+
+typedef struct pinger {
+    actor_id_t ponger;
+    long sent_at;
+} pinger_t;
+
+static void pp_pinger_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    static pinger_t pinger;
+
+    pinger.ponger = actor_spawn(&pp_ponger_role, (void*) actor_id_self());
+    if (pinger.ponger < 0)
+        fatal("actor_spawn failed");
+
+    *stateptr      = &pinger;
+    pinger.sent_at = now_ns();
+    send_or_die(pinger.ponger, (message_t) { .message_type = MSG_PING });
+}
+
+static void pp_pinger_pong(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    pinger_t *pinger = *stateptr;
+    long now = now_ns();
+
+    samples[n_samples++] = now - pinger->sent_at;
+
+    if (n_samples < pp_rounds) {
+        pinger->sent_at = now;
+        send_or_die(pinger->ponger, (message_t) { .message_type = MSG_PING });
+    } else {
+        send_or_die(pinger->ponger, (message_t) { .message_type = MSG_GODIE });
+        die();
+    }
+}
+
+static void pp_ponger_ping(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    send_or_die((actor_id_t) *stateptr, (message_t) { .message_type = MSG_PONG });
+}
+
+static void nothing(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+}
+
+static void bench_pingpong() {
+    char params[64];
+    act_t pinger_prompts[] = { pp_pinger_hello, nothing, pp_pinger_pong };
+    act_t ponger_prompts[] = { nothing, pp_ponger_ping };
+    role_t pinger_role = { .nprompts = 3, .prompts = pinger_prompts };
+    pp_ponger_role = (role_t) { .nprompts = 2, .prompts = ponger_prompts };
+
+    pp_rounds = scaled(100000);
+    start_samples(pp_rounds);
+
+    long ns = run_system(&pinger_role);
+    snprintf(params, sizeof(params), "rounds=%ld", pp_rounds);
+    report("pingpong", params, 2 * pp_rounds, ns);
+}
+
+// fanout
+
+static long fo_width, fo_rounds;
+static actor_id_t fo_root;
+static actor_id_t *fo_leaves;
+static role_t fo_leaf_role;
+
+typedef struct root {
+    long replies;       ///< replies to the current round
+    long sent_at;
+} root_t;
+
+static void fo_send_round(root_t *root) {
+    long i;
+
+    root->replies = 0;
+    root->sent_at = now_ns();
+    for (i = 0; i < fo_width; ++i)
+        send_or_die(fo_leaves[i], (message_t) { .message_type = MSG_PING });
+}
+
+static void fo_root_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    static root_t root;
+
+    fo_root = actor_id_self();
+    if (actor_spawn_many(&fo_leaf_role, fo_width, NULL, fo_leaves) != 0)
+        fatal("actor_spawn_many failed");
+
+    *stateptr = &root;
+    fo_send_round(&root);
+}
+
+static void fo_root_pong(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    root_t *root = *stateptr;
+    long i;
+
+    if (++root->replies < fo_width)
+        return;
+
+    samples[n_samples++] = now_ns() - root->sent_at;
+
+    if (n_samples < fo_rounds) {
+        fo_send_round(root);
+        return;
+    }
+
+    for (i = 0; i < fo_width; ++i)
+        send_or_die(fo_leaves[i], (message_t) { .message_type = MSG_GODIE });
+    die();
+}
+
+static void fo_leaf_ping(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    send_or_die(fo_root, (message_t) { .message_type = MSG_PONG });
+}
+
+static void bench_fanout() {
+    char params[64];
+    act_t root_prompts[] = { fo_root_hello, nothing, fo_root_pong };
+    act_t leaf_prompts[] = { nothing, fo_leaf_ping };
+    role_t root_role = { .nprompts = 3, .prompts = root_prompts };
+    fo_leaf_role = (role_t) { .nprompts = 2, .prompts = leaf_prompts };
+
+    fo_width  = 256; // the replies of a round fit into the root's mailbox
+    fo_rounds = scaled(1000);
+    fo_leaves = malloc(fo_width * sizeof(actor_id_t));
+    start_samples(fo_rounds);
+
+    long ns = run_system(&root_role);
+    snprintf(params, sizeof(params), "width=%ld rounds=%ld", fo_width, fo_rounds);
+    report("fanout", params, 2 * fo_width * fo_rounds, ns);
+    free(fo_leaves);
+}
+
+// chain
+
+static long ch_length;
+static int ch_started;                  ///< 1 once the first actor has said hello
+static long ch_spawned_at;              ///< when the last hop began, written by one actor at a time
+static role_t ch_role;
+
+static void ch_spawn_next() {
+    ch_spawned_at = now_ns();
+    send_or_die(actor_id_self(), (message_t) { .message_type = MSG_SPAWN, .data = &ch_role });
+}
+
+static void ch_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+
+    if (!ch_started) { // the first actor, whose id may well be 0
+        ch_started = 1;
+        ch_spawn_next();
+    }
+    else
+        send_or_die((actor_id_t) data, (message_t) { .message_type = MSG_READY, .data = (void*) actor_id_self() });
+}
+
+static void ch_ready(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    send_or_die((actor_id_t) data, (message_t) { .message_type = MSG_STATE, .data = *stateptr });
+    die();
+}
+
+static void ch_state(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    long hops = (long) data + 1;
+
+    samples[n_samples++] = now_ns() - ch_spawned_at;
+    *stateptr = (void*) hops;
+
+    if (hops < ch_length)
+        ch_spawn_next();
+    else
+        die();
+}
+
+static void bench_chain() {
+    char params[64];
+    act_t prompts[] = { ch_hello, ch_ready, ch_state };
+    ch_role = (role_t) { .nprompts = 3, .prompts = prompts };
+
+    ch_length  = scaled(100000);
+    ch_started = 0;
+    start_samples(ch_length);
+
+    long ns = run_system(&ch_role);
+    snprintf(params, sizeof(params), "length=%ld", ch_length);
+    report("chain", params, 5 * ch_length, ns); // MSG_SPAWN, MSG_HELLO, MSG_READY, MSG_STATE, MSG_GODIE
+}
+
+// ring
+
+static long rg_size, rg_tokens, rg_laps;
+static actor_id_t *rg_members;
+static long *rg_lap_started;            ///< when each token set off on its lap, written only by member 0
+static long rg_finished;                ///< tokens back from their last lap, written only by member 0
+static role_t rg_role;
+
+static void rg_first_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    long i;
+    void **states = malloc((rg_size - 1) * sizeof(void*));
+
+    for (i = 1; i < rg_size; ++i)
+        states[i - 1] = (void*) i;
+
+    rg_members[0] = actor_id_self();
+    *stateptr     = (void*) 0L;
+    if (actor_spawn_many(&rg_role, rg_size - 1, states, rg_members + 1) != 0)
+        fatal("actor_spawn_many failed");
+    free(states);
+
+    // a token is its number plus rg_tokens times the hops it has left
+    for (i = 0; i < rg_tokens; ++i) {
+        rg_lap_started[i] = now_ns();
+        send_or_die(rg_members[1], (message_t) {
+                .message_type = MSG_PING, .data = (void*) (i + rg_tokens * (rg_size * rg_laps - 1))
+        });
+    }
+}
+
+static void rg_token(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    long position = (long) *stateptr, token = (long) data % rg_tokens, left = (long) data / rg_tokens, i;
+
+    if (position == 0) {
+        long now = now_ns();
+        samples[n_samples++]  = now - rg_lap_started[token];
+        rg_lap_started[token] = now;
+
+        if (left == 0) {
+            if (++rg_finished < rg_tokens)
+                return;
+            for (i = 0; i < rg_size; ++i)
+                send_or_die(rg_members[i], (message_t) { .message_type = MSG_GODIE });
+            return;
+        }
+    }
+
+    send_or_die(rg_members[(position + 1) % rg_size], (message_t) {
+            .message_type = MSG_PING, .data = (void*) (token + rg_tokens * (left - 1))
+    });
+}
+
+static void bench_ring() {
+    char params[64];
+    act_t first_prompts[] = { rg_first_hello, rg_token };
+    act_t prompts[] = { nothing, rg_token };
+    role_t first_role = { .nprompts = 2, .prompts = first_prompts };
+    rg_role = (role_t) { .nprompts = 2, .prompts = prompts };
+
+    rg_size        = 64;
+    rg_tokens      = 8;
+    rg_laps        = scaled(1000);
+    rg_finished    = 0;
+    rg_members     = malloc(rg_size * sizeof(actor_id_t));
+    rg_lap_started = malloc(rg_tokens * sizeof(long));
+    start_samples(rg_tokens * rg_laps);
+
+    long ns = run_system(&first_role);
+    snprintf(params, sizeof(params), "size=%ld tokens=%ld laps=%ld", rg_size, rg_tokens, rg_laps);
+    report("ring", params, rg_size * rg_tokens * rg_laps, ns);
+    free(rg_members);
+    free(rg_lap_started);
+}
+
+// queue and bqueue
+
+static long qu_per_producer;
+static queue_t *qu_queue;
+static blocking_queue_t *qu_blocking;
+static atomic_long qu_popped;           ///< bqueue: messages taken by all consumers
+static pthread_mutex_t qu_samples_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/// pushes messages carrying the time they were pushed at
+static void* qu_producer(void *arg) {
+    UNUSED_PARAMETER(arg);
+    long i;
+
+    for (i = 0; i < qu_per_producer; ++i) {
+        long at = i % QUEUE_SAMPLE == 0 ? now_ns() : 0;
+
+        if (qu_queue != NULL)
+            queue_push(qu_queue, (message_t) { .message_type = MSG_PING, .nbytes = (size_t) at });
+        else
+            blocking_queue_push(qu_blocking, at);
+    }
+
+    return NULL;
+}
+
+/// bqueue: pops until a negative id, which producers never push
+static void* qu_consumer(void *arg) {
+    UNUSED_PARAMETER(arg);
+    actor_id_t at;
+
+    while (blocking_queue_pop(qu_blocking, &at) == 0 && at >= 0) {
+        if (at > 0) {
+            long latency = now_ns() - at;
+            safe_lock(&qu_samples_lock);
+            samples[n_samples++] = latency;
+            safe_unlock(&qu_samples_lock);
+        }
+        atomic_fetch_add(&qu_popped, 1);
+    }
+
+    return NULL;
+}
+
+static void start_threads(pthread_t *threads, int n, void *(*routine)(void*)) {
+    int i, err;
+    for (i = 0; i < n; ++i)
+        if ((err = pthread_create(&threads[i], NULL, routine, NULL)) != 0)
+            syserr(err, "pthread_create failed");
+}
+
+static void join_threads(pthread_t *threads, int n) {
+    int i, err;
+    for (i = 0; i < n; ++i)
+        if ((err = pthread_join(threads[i], NULL)) != 0)
+            syserr(err, "pthread_join failed");
+}
+
+static void bench_queue() {
+    char params[64];
+    int producers = n_workers;
+    long popped = 0, total;
+    message_t message;
+    pthread_t threads[producers];
+
+    qu_per_producer = scaled(1000000);
+    total           = producers * qu_per_producer;
+    qu_queue        = queue_init();
+    start_samples(total / QUEUE_SAMPLE + producers);
+
+    long start = now_ns();
+    start_threads(threads, producers, qu_producer);
+
+    while (popped < total) {
+        if (queue_pop(qu_queue, &message) != 0)
+            continue;
+        if (message.nbytes != 0)
+            samples[n_samples++] = now_ns() - (long) message.nbytes;
+        ++popped;
+    }
+
+    long ns = now_ns() - start;
+    join_threads(threads, producers);
+    queue_destroy(qu_queue);
+    qu_queue = NULL;
+
+    snprintf(params, sizeof(params), "producers=%d consumers=1", producers);
+    report("queue", params, total, ns);
+}
+
+static void bench_bqueue() {
+    char params[64];
+    int i, producers = n_workers, consumers = n_workers;
+    pthread_t producer_threads[producers], consumer_threads[consumers];
+
+    qu_per_producer = scaled(200000);
+    qu_blocking     = blocking_queue_init();
+    atomic_store(&qu_popped, 0);
+    start_samples(producers * qu_per_producer / QUEUE_SAMPLE + producers);
+
+    long start = now_ns();
+    start_threads(consumer_threads, consumers, qu_consumer);
+    start_threads(producer_threads, producers, qu_producer);
+    join_threads(producer_threads, producers);
+
+    for (i = 0; i < consumers; ++i)
+        blocking_queue_push(qu_blocking, -1);
+    join_threads(consumer_threads, consumers);
+    long ns = now_ns() - start;
+
+    blocking_queue_signal_all(qu_blocking);
+    blocking_queue_destroy(qu_blocking);
+    qu_blocking = NULL;
+
+    snprintf(params, sizeof(params), "producers=%d consumers=%d", producers, consumers);
+    report("bqueue", params, atomic_load(&qu_popped), ns);
+}
+
+typedef struct workload {
+    const char *name;
+    void (*run)();
+} workload_t;
+
+static const workload_t workloads[] = {
+        { "pingpong", bench_pingpong },
+        { "fanout",   bench_fanout },
+        { "chain",    bench_chain },
+        { "ring",     bench_ring },
+        { "queue",    bench_queue },
+        { "bqueue",   bench_bqueue },
+};
+
+#define N_WORKLOADS (int) (sizeof(workloads) / sizeof(workloads[0]))
+
+int main(int argc, char *argv[]) {
+    int i, j, opt;
+
+    n_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    while ((opt = getopt(argc, argv, "w:s:")) != -1) {
+        switch (opt) {
+            case 'w': n_workers = atoi(optarg); break;
+            case 's': scale = atof(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-w workers] [-s scale] [workload ...]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (n_workers < 1)
+        n_workers = 1;
+
+    if (optind == argc) {
+        for (j = 0; j < N_WORKLOADS; ++j)
+            workloads[j].run();
+        return 0;
+    }
+
+    for (i = optind; i < argc; ++i) {
+        for (j = 0; j < N_WORKLOADS && strcmp(argv[i], workloads[j].name) != 0; ++j);
+        if (j == N_WORKLOADS) {
+            fprintf(stderr, "unknown workload: %s\n", argv[i]);
+            return 1;
+        }
+        workloads[j].run();
+    }
+
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include "blocking_queue.h"
 #include "err.h"
+#include "slab.h"
 
 blocking_queue_t* blocking_queue_init() {
     int err;
@@ -26,8 +27,7 @@ blocking_queue_t* blocking_queue_init() {
 int blocking_queue_push(blocking_queue_t *bq, actor_id_t id) {
     int err;
 
-    blocking_entry_t *new_entry = malloc(sizeof(blocking_entry_t));
-    if (new_entry == NULL) return -1;
+    blocking_entry_t *new_entry = slab_alloc(sizeof(blocking_entry_t));
 
     new_entry->data = id;
     new_entry->prev = NULL;
@@ -43,16 +43,12 @@ int blocking_queue_push(blocking_queue_t *bq, actor_id_t id) {
 
     bq->back = new_entry;
 
-    if (bq->len == 0)
-        if ((err = pthread_cond_signal(&bq->ready)) != 0) // if no thread waits then nothing happens
-            syserr(err, "cond signal failed");
+    // every push wakes a consumer, others may be waiting even if the queue is not empty
+    if ((err = pthread_cond_signal(&bq->ready)) != 0) // if no thread waits then nothing happens
+        syserr(err, "cond signal failed");
 
     bq->len++;
 
-#ifdef DEBUG
-    fprintf(stdout,"BQ push: %ld\n", id);
-#endif
-
     safe_unlock(&bq->lock);
 
     return 0;
@@ -79,18 +75,36 @@ int blocking_queue_pop(blocking_queue_t *bq, actor_id_t *actor) {
     res = pop->data;
     bq->front = pop->prev;
 
-    free(pop);
+    slab_free(pop);
 
     bq->len--;
-#ifdef DEBUG
-    fprintf(stdout,"BQ pop: %ld\n", res);
-#endif
     safe_unlock(&bq->lock);
     *actor = res;
     return 0;
 
 }
 
+int blocking_queue_try_pop(blocking_queue_t *bq, actor_id_t *actor) {
+    blocking_entry_t* volatile pop;
+
+    safe_lock(&bq->lock);
+
+    if (bq->len == 0 || bq->interrupted == 1) {
+        safe_unlock(&bq->lock);
+        return -1;
+    }
+
+    pop = bq->front;
+    *actor = pop->data;
+    bq->front = pop->prev;
+    bq->len--;
+
+    safe_unlock(&bq->lock);
+
+    slab_free(pop);
+    return 0;
+}
+
 void blocking_queue_signal_all(blocking_queue_t *bq) {
     int err;
     safe_lock(&bq->lock);
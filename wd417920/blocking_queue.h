@@ -35,6 +35,14 @@ extern int blocking_queue_push(blocking_queue_t *bq, actor_id_t id);
  */
 extern int blocking_queue_pop(blocking_queue_t *bq, actor_id_t *actor);
 
+/**
+ * A non-blocking variant of blocking_queue_pop.
+ * @param[in] bq        - a queue on which the operation shall be performed,
+ * @param[out] actor    - a pointer to element removed from the queue,
+ * @return              - 0 if an element was removed, -1 if the queue was empty or interrupted
+ */
+extern int blocking_queue_try_pop(blocking_queue_t *bq, actor_id_t *actor);
+
 extern void blocking_queue_signal_all(blocking_queue_t *bq);
 
 extern int blocking_queue_empty(blocking_queue_t *bq);
@@ -1,22 +1,28 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
 #include <signal.h>
 #include <string.h>
 #include <signal.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include "err.h"
 #include "cacti.h"
 #include "messages.h"
+#include "slab.h"
+#include "topology.h"
+#include "trace.h"
 
 // TODO: change SIGQUIT to SIGINT
 #define SIG_END         SIGQUIT
 #define SIG_INTERRUPT   (SIGRTMIN + 2)
 
 typedef struct thread_pool_t {
-    pthread_key_t curr_actor;
     pthread_attr_t attr;        ///< attributes of thread creation
-    pthread_t tid[POOL_SIZE];   ///< ids of threads in the pool
+    int size;                   ///< number of threads in the pool
+    pthread_t *tid;             ///< ids of threads in the pool
     pthread_mutex_t lock;       ///< mutex used to determine the last thread that ends
     int ended;                  ///< number of threads that finished
     pthread_t help_tid;         ///< tid of signal handler
@@ -29,74 +35,95 @@ typedef struct thread_specific {
     actor_id_t actor;
 } thread_specific_t;
 
-thread_pool TP; ///< System's thread pool
+/**
+ * A system of actors with a thread pool of its own.
+ */
+struct cacti_system {
+    thread_pool tp;                 ///< workers of the system
+    actors_t *ac;                   ///< actors of the system
+    struct cacti_system *next;      ///< next running system
+};
+
+/// a worker and the system it works for
+typedef struct worker_arg {
+    cacti_system_t *system;
+    int dispatcher;             ///< 0 for the default dispatcher, i for config.dispatchers[i - 1]
+    int id;                     ///< number of the worker in its dispatcher
+} worker_arg_t;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t curr_actor;                ///< thread_specific_t of the calling worker
+
+static pthread_mutex_t systems_lock = PTHREAD_MUTEX_INITIALIZER;
+static cacti_system_t *systems = NULL;          ///< systems that have not been joined yet
+
+static cacti_system_t *default_system = NULL;   ///< system of actor_system_create
+static __thread cacti_system_t *own_system = NULL; ///< system the calling worker belongs to
 
 
 /**
  * The life of a special thread (which handles the signal)
- * @param data
+ * @param data     - the system the thread belongs to
  * @return
  */
-void *worker_signal() {
+void *worker_signal(void *data) {
+    cacti_system_t *system = data, *s;
     int err, sig;
 
-    if ((err = sigwait(&TP.set, &sig)) != 0)
+    if ((err = sigwait(&system->tp.set, &sig)) != 0)
         syserr(err, "sig wait failed");
 
-    if (sig == SIG_END)
-        interrupt_all();
+    // the signal is sent to the process, one of the systems gets it for all
+    if (sig == SIG_END) {
+        safe_lock(&systems_lock);
+        for (s = systems; s != NULL; s = s->next)
+            interrupt_all(s->ac);
+        safe_unlock(&systems_lock);
+    }
 
     return NULL;
 }
 
 /**
  * The life of a thread.
- * @param data     - number of this thread
+ * @param data     - the system and number of this thread
  * @return         NULL
  */
 void *worker(void* data) {
-    int id = *(int*) data;
+    cacti_system_t *system = ((worker_arg_t*) data)->system;
+    thread_pool *tp = &system->tp;
+    int dispatcher = ((worker_arg_t*) data)->dispatcher;
+    int id = ((worker_arg_t*) data)->id;
     int is_last = 0, err;
     free(data);
 
-    pthread_t tid = pthread_self();
-    TP.tid[id] = tid;
-
     // thread specific data
     thread_specific_t *ts = malloc(sizeof(thread_specific_t));
-    pthread_setspecific(TP.curr_actor, ts);
+    pthread_setspecific(curr_actor, ts);
+    own_system = system;
 
     computation_t c;
+    attach_worker(system->ac, dispatcher, id);
 
     while (1) {
-        if (next_computation(&c) != 0) break;
+        if (next_computation(system->ac, id, &c) != 0) break;
         ts->actor = c.actor;
 
-        if (c.prompt != NULL) {
-            (*(c.prompt))(c.stateptr, c.message.nbytes, c.message.data);
-        }
-        computation_ended(c.actor);
+        // run the actor for as long as its quota allows
+        do {
+            run_computation(system->ac, &c);
+        } while (continue_computation(system->ac, &c) == 0);
+
+        computation_ended(system->ac, &c);
     }
 
-    safe_lock(&TP.lock);
-    if (++TP.ended == POOL_SIZE) is_last = 1;
-    safe_unlock(&TP.lock);
+    safe_lock(&tp->lock);
+    if (++tp->ended == tp->size) is_last = 1;
+    safe_unlock(&tp->lock);
 
     if (is_last) {
-        // last thread, must clean the system
-        if ((err = pthread_key_delete(TP.curr_actor)) != 0)
-            syserr(err, "key delete failed");
-
-        if ((err = pthread_mutex_destroy (&TP.lock)) != 0)
-            syserr (err, "mutex destroy failed (pool.c)");
-
-        if ((err = pthread_attr_destroy (&TP.attr)) != 0)
-            syserr(err, "attr destroy failed");
-
-        messages_destroy();
-
-        // restore old signal mask
-        if ((err = pthread_sigmask(SIG_BLOCK, &TP.old_mask, NULL)) != 0)
+        // restore old signal mask, the rest is cleaned up by the joining thread
+        if ((err = pthread_sigmask(SIG_BLOCK, &tp->old_mask, NULL)) != 0)
             syserr(err, "pthread_sigmask failed");
     }
 
@@ -106,72 +133,466 @@ void *worker(void* data) {
 }
 
 int actor_system_create(actor_id_t *actor, role_t *const role) {
-    int i, err;
-    if (init_actors_system(actor, role) != 0) {
+    actor_system_config_t config = { .n_workers = POOL_SIZE };
+    return actor_system_create_ex(actor, role, &config);
+}
+
+int actor_system_create_ex(actor_id_t *actor, role_t *const role, const actor_system_config_t *config) {
+    cacti_system_t *system = cacti_system_create(actor, role, config);
+
+    if (system == NULL)
         return -1;
+
+    default_system = system;
+    return 0;
+}
+
+/**
+ * Pins the next thread created with attr to the CPUs of mask.
+ * @return  0 on success, -1 if the mask is empty
+ */
+static int set_affinity(pthread_attr_t *attr, const cpu_mask_t *mask) {
+    int cpu, err;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (cpu = 0; cpu < CPU_MASK_MAX && cpu < CPU_SETSIZE; ++cpu)
+        if (mask->cpus[cpu / 64] & (1ULL << (cpu % 64)))
+            CPU_SET(cpu, &set);
+
+    if (CPU_COUNT(&set) == 0)
+        return -1;
+
+    if ((err = pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &set)) != 0)
+        syserr(err, "set affinity");
+
+    return 0;
+}
+
+static void create_key() {
+    int err;
+    if ((err = pthread_key_create(&curr_actor, NULL)) != 0)
+        syserr(err, "key create failed");
+}
+
+/// 0 if every dispatcher has a name of its own and some workers, -1 o/w
+static int check_dispatchers(const actor_system_config_t *config) {
+    size_t i, j;
+
+    for (i = 0; i < config->n_dispatchers; ++i) {
+        if (config->dispatchers[i].name == NULL || config->dispatchers[i].n_workers <= 0)
+            return -1;
+
+        for (j = 0; j < i; ++j)
+            if (strcmp(config->dispatchers[i].name, config->dispatchers[j].name) == 0)
+                return -1;
+    }
+
+    return 0;
+}
+
+cacti_system_t *cacti_system_create(actor_id_t *actor, role_t *const role, const actor_system_config_t *config) {
+    int i, d, err, n_nodes = topology_nodes(), n_threads, first;
+    actor_system_config_t resolved = *config;
+    cacti_system_t *system;
+    thread_pool *tp;
+    worker_arg_t *arg;
+    int *node;
+
+    if (resolved.n_workers <= 0)
+        resolved.n_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (resolved.n_workers <= 0)
+        resolved.n_workers = POOL_SIZE;
+
+    if (check_dispatchers(&resolved) != 0)
+        return NULL;
+
+    n_threads = resolved.n_workers;
+    for (d = 0; d < (int) resolved.n_dispatchers; ++d)
+        n_threads += resolved.dispatchers[d].n_workers;
+
+    // one group of workers of each dispatcher per NUMA node, unless the caller has pinned the default ones
+    node = safe_malloc(n_threads * sizeof(int));
+    for (i = 0; i < resolved.n_workers; ++i)
+        node[i] = resolved.affinity != NULL ? topology_node_of_mask(&resolved.affinity[i]) : i % n_nodes;
+    for (d = 0, first = resolved.n_workers; d < (int) resolved.n_dispatchers; ++d) {
+        for (i = 0; i < resolved.dispatchers[d].n_workers; ++i)
+            node[first + i] = i % n_nodes;
+        first += resolved.dispatchers[d].n_workers;
     }
 
-    TP.ended = 0;
+    system = safe_malloc(sizeof(cacti_system_t));
+    tp     = &system->tp;
 
-    if ((err = pthread_attr_init(&TP.attr)) != 0)
+    if ((system->ac = init_actors_system(actor, role, &resolved, node)) == NULL) {
+        free(node);
+        free(system);
+        return NULL;
+    }
+
+    tp->ended = 0;
+    tp->size  = n_threads;
+    tp->tid   = safe_malloc(tp->size * sizeof(pthread_t));
+
+    if ((err = pthread_attr_init(&tp->attr)) != 0)
         syserr(err, "attr_init");
 
-    if ((err = pthread_attr_setdetachstate(&TP.attr, PTHREAD_CREATE_JOINABLE)) != 0)
+    if ((err = pthread_attr_setdetachstate(&tp->attr, PTHREAD_CREATE_JOINABLE)) != 0)
         syserr(err, "set detach state");
 
-    // set up thread specific struct
-    if ((err = pthread_key_create(&TP.curr_actor, NULL)) != 0)
-        syserr(err, "key create failed");
+    if (resolved.stack_size != 0 && (err = pthread_attr_setstacksize(&tp->attr, resolved.stack_size)) != 0)
+        syserr(err, "set stack size");
+
+    // set up thread specific struct, shared by all systems
+    if ((err = pthread_once(&key_once, create_key)) != 0)
+        syserr(err, "once failed");
 
     // init mutex
-    if ((err = pthread_mutex_init(&TP.lock, 0)) != 0)
+    if ((err = pthread_mutex_init(&tp->lock, 0)) != 0)
         syserr(err, "mutex init failed");
 
     // block SIGINT in this thread and all the future child threads
-    sigemptyset(&TP.set);
-    sigaddset(&TP.set, SIG_END);
-    sigaddset(&TP.set, SIG_INTERRUPT);
-    if ((err = pthread_sigmask(SIG_BLOCK, &TP.set, &TP.old_mask)) != 0)
+    sigemptyset(&tp->set);
+    sigaddset(&tp->set, SIG_END);
+    sigaddset(&tp->set, SIG_INTERRUPT);
+    if ((err = pthread_sigmask(SIG_BLOCK, &tp->set, &tp->old_mask)) != 0)
         syserr(err, "pthread_sigmask failed");
 
-    // create threads
-    int* t_num;
-    for (i = 0; i < POOL_SIZE; ++i) {
-        t_num = safe_malloc(sizeof(int));
-        *t_num = i;
-        if ((err = pthread_create(&TP.tid[i], &TP.attr, worker, (void*) t_num)) != 0) {
+    safe_lock(&systems_lock);
+    system->next = systems;
+    systems      = system;
+    safe_unlock(&systems_lock);
+
+    // create threads, those of the default dispatcher first
+    for (i = 0, d = 0, first = 0; i < tp->size; ++i) {
+        if (d == 0 && i == resolved.n_workers)
+            d = 1, first = i;
+        else if (d > 0 && i - first == resolved.dispatchers[d - 1].n_workers)
+            d++, first = i;
+
+        if (d == 0 && resolved.affinity != NULL && set_affinity(&tp->attr, &resolved.affinity[i]) != 0)
+            fatal("empty affinity mask of worker %d", i);
+        if ((d > 0 || resolved.affinity == NULL) && n_nodes > 1
+                && set_affinity(&tp->attr, topology_node_cpus(node[i])) != 0)
+            fatal("no CPUs on NUMA node %d", node[i]);
+
+        arg = safe_malloc(sizeof(worker_arg_t));
+        arg->system     = system;
+        arg->dispatcher = d;
+        arg->id         = i - first;
+        if ((err = pthread_create(&tp->tid[i], &tp->attr, worker, (void*) arg)) != 0) {
             syserr(err, "create");
         }
     }
 
+    free(node);
+
     // create a special thread
-    if ((err = pthread_create(&TP.help_tid, &TP.attr, worker_signal, NULL)) != 0) {
+    if ((err = pthread_create(&tp->help_tid, NULL, worker_signal, system)) != 0) {
         syserr(err, "create");
     }
 
-    return 0;
+    return system;
 }
 
 actor_id_t actor_id_self() {
-    thread_specific_t *tp = pthread_getspecific(TP.curr_actor);
-    if (tp == NULL) {
+    thread_specific_t *ts = own_system != NULL ? pthread_getspecific(curr_actor) : NULL;
+    if (ts == NULL) {
         fatal("actor_id_self used incorrectly");
     }
-    return tp->actor;
+    return ts->actor;
 }
 
-void actor_system_join(actor_id_t actor) {
-    (void)(actor); // suppress unused argument warning
+cacti_system_t *cacti_system_self() {
+    return own_system;
+}
+
+void cacti_system_join(cacti_system_t *system) {
     int i, err;
+    thread_pool *tp = &system->tp;
+    cacti_system_t **s;
 
-    for (i = 0; i < POOL_SIZE; ++i) {
-        if ((err = pthread_join(TP.tid[i], NULL)) != 0)
+    for (i = 0; i < tp->size; ++i) {
+        if ((err = pthread_join(tp->tid[i], NULL)) != 0)
             syserr(err, "join failed");
     }
+    free(tp->tid);
 
-    pthread_kill(TP.help_tid, SIG_INTERRUPT);
+    pthread_kill(tp->help_tid, SIG_INTERRUPT);
 
-    if ((err = pthread_join(TP.help_tid, NULL)) != 0)
+    if ((err = pthread_join(tp->help_tid, NULL)) != 0)
         syserr(err, "join failed");
 
-}
\ No newline at end of file
+    safe_lock(&systems_lock);
+    for (s = &systems; *s != system; s = &(*s)->next);
+    *s = system->next;
+    safe_unlock(&systems_lock);
+
+    if ((err = pthread_mutex_destroy (&tp->lock)) != 0)
+        syserr (err, "mutex destroy failed (pool.c)");
+
+    if ((err = pthread_attr_destroy (&tp->attr)) != 0)
+        syserr(err, "attr destroy failed");
+
+    messages_destroy(system->ac);
+    free(system);
+}
+
+void actor_system_join(actor_id_t actor) {
+    (void)(actor); // suppress unused argument warning
+    cacti_system_t *system = default_system;
+
+    if (system == NULL)
+        return;
+
+    cacti_system_join(system);
+    default_system = NULL;
+}
+
+/// the system of the calling worker, or the default one outside of pools
+static inline actors_t* current_actors() {
+    cacti_system_t *system = own_system != NULL ? own_system : default_system;
+    return system != NULL ? system->ac : NULL;
+}
+
+static int send_to(actors_t *ac, actor_id_t actor, message_t message, const void *payload, int flags) {
+    if (ac == NULL)
+        return -2;
+    return push_message(ac, actor, message, payload, flags);
+}
+
+static int send_inline_to(actors_t *ac, actor_id_t actor, message_type_t message_type,
+                          const void *payload, size_t nbytes) {
+    if (nbytes > MESSAGE_INLINE_MAX || message_type == MSG_SPAWN)
+        return -2;
+
+    return send_to(ac, actor, (message_t) {
+            .message_type = message_type,
+            .nbytes = nbytes
+    }, nbytes != 0 ? payload : NULL, 0);
+}
+
+static int send_timed_to(actors_t *ac, actor_id_t actor, message_t message, long timeout_ns) {
+    if (ac == NULL)
+        return -2;
+    return push_message_timed(ac, actor, message, timeout_ns);
+}
+
+int send_message(actor_id_t actor, message_t message) {
+    return send_to(current_actors(), actor, message, NULL, 0);
+}
+
+int send_message_try(actor_id_t actor, message_t message) {
+    return send_to(current_actors(), actor, message, NULL, 0);
+}
+
+int send_message_urgent(actor_id_t actor, message_t message) {
+    return send_to(current_actors(), actor, message, NULL, PUSH_URGENT);
+}
+
+int send_message_inline(actor_id_t actor, message_type_t message_type, const void *payload, size_t nbytes) {
+    return send_inline_to(current_actors(), actor, message_type, payload, nbytes);
+}
+
+int send_message_timed(actor_id_t actor, message_t message, long timeout_ns) {
+    return send_timed_to(current_actors(), actor, message, timeout_ns);
+}
+
+static timer_id_t schedule_to(actors_t *ac, actor_id_t actor, message_t message, long delay_ns, long period_ns) {
+    if (ac == NULL)
+        return -2;
+    return schedule_message(ac, actor, message, delay_ns, period_ns);
+}
+
+timer_id_t send_message_after(actor_id_t actor, message_t message, long delay_ns) {
+    return schedule_to(current_actors(), actor, message, delay_ns, 0);
+}
+
+timer_id_t send_message_every(actor_id_t actor, message_t message, long delay_ns, long period_ns) {
+    return schedule_to(current_actors(), actor, message, delay_ns, period_ns > 0 ? period_ns : 1);
+}
+
+int cancel_timer(timer_id_t timer) {
+    actors_t *ac = current_actors();
+    return ac != NULL ? cancel_scheduled(ac, timer) : -1;
+}
+
+static future_t ask_to(cacti_system_t *system, actor_id_t actor, message_t message) {
+    if (system == NULL)
+        return (future_t) { .system = NULL, .id = -2 };
+    return (future_t) { .system = system, .id = ask_message(system->ac, actor, message) };
+}
+
+future_t actor_ask(actor_id_t actor, message_t message) {
+    return ask_to(own_system != NULL ? own_system : default_system, actor, message);
+}
+
+future_t actor_request() {
+    return (future_t) { .system = own_system != NULL ? own_system : default_system, .id = current_future() };
+}
+
+int actor_reply(future_t future, void *reply) {
+    if (future.system == NULL || future.id < 0)
+        return -1;
+    return reply_future(future.system->ac, future.id, reply);
+}
+
+int future_wait(future_t future, long timeout_ns, void **reply) {
+    if (future.system == NULL || future.id < 0)
+        return -2;
+    return wait_future(future.system->ac, future.id, timeout_ns, reply);
+}
+
+int future_then(future_t future, message_type_t message_type) {
+    if (future.system == NULL || future.id < 0)
+        return -2;
+    return then_future(future.system->ac, future.id, message_type);
+}
+
+int future_cancel(future_t future) {
+    if (future.system == NULL || future.id < 0)
+        return -2;
+    return cancel_future(future.system->ac, future.id);
+}
+
+static size_t multicast_to(actors_t *ac, const actor_id_t *actors, size_t n, message_type_t message_type,
+                           const void *payload, size_t nbytes, int *results) {
+    size_t i;
+
+    if (ac != NULL)
+        return multicast(ac, actors, n, message_type, payload, nbytes, results);
+
+    for (i = 0; results != NULL && i < n; ++i)
+        results[i] = -2;
+    return 0;
+}
+
+size_t send_multicast(const actor_id_t *actors, size_t n, message_type_t message_type,
+                      const void *payload, size_t nbytes, int *results) {
+    return multicast_to(current_actors(), actors, n, message_type, payload, nbytes, results);
+}
+
+actor_id_t actor_spawn(role_t *const role, void *state) {
+    return cacti_spawn(own_system != NULL ? own_system : default_system, role, state);
+}
+
+int actor_spawn_many(role_t *const role, size_t n, void *const *states, actor_id_t *ids) {
+    return cacti_spawn_many(own_system != NULL ? own_system : default_system, role, n, states, ids);
+}
+
+actor_id_t cacti_spawn(cacti_system_t *system, role_t *const role, void *state) {
+    actor_id_t actor;
+    return cacti_spawn_many(system, role, 1, &state, &actor) == 0 ? actor : -1;
+}
+
+int cacti_spawn_many(cacti_system_t *system, role_t *const role, size_t n, void *const *states, actor_id_t *ids) {
+    if (system == NULL)
+        return -1;
+    return spawn_actors(system->ac, role, NULL, n, states, ids);
+}
+
+actor_id_t actor_spawn_on(const char *dispatcher, role_t *const role, void *state) {
+    return cacti_spawn_on(own_system != NULL ? own_system : default_system, dispatcher, role, state);
+}
+
+actor_id_t cacti_spawn_on(cacti_system_t *system, const char *dispatcher, role_t *const role, void *state) {
+    actor_id_t actor;
+
+    if (system == NULL)
+        return -1;
+    return spawn_actors(system->ac, role, dispatcher, 1, &state, &actor) == 0 ? actor : -1;
+}
+
+int actor_await(message_type_t message_type, message_t *message) {
+    return await_message(message_type, message);
+}
+
+long actor_migrations(actor_id_t actor) {
+    actors_t *ac = current_actors();
+    return ac != NULL ? actor_migrations_of(ac, actor) : -2;
+}
+
+int actor_stats(actor_id_t actor, actor_stats_t *stats) {
+    actors_t *ac = current_actors();
+    return ac != NULL ? actor_stats_of(ac, actor, stats) : -2;
+}
+
+int cacti_send(cacti_system_t *system, actor_id_t actor, message_t message) {
+    return send_to(system->ac, actor, message, NULL, 0);
+}
+
+int cacti_send_urgent(cacti_system_t *system, actor_id_t actor, message_t message) {
+    return send_to(system->ac, actor, message, NULL, PUSH_URGENT);
+}
+
+int cacti_send_inline(cacti_system_t *system, actor_id_t actor, message_type_t message_type,
+                      const void *payload, size_t nbytes) {
+    return send_inline_to(system->ac, actor, message_type, payload, nbytes);
+}
+
+size_t cacti_send_multicast(cacti_system_t *system, const actor_id_t *actors, size_t n, message_type_t message_type,
+                            const void *payload, size_t nbytes, int *results) {
+    return multicast_to(system->ac, actors, n, message_type, payload, nbytes, results);
+}
+
+int cacti_send_timed(cacti_system_t *system, actor_id_t actor, message_t message, long timeout_ns) {
+    return send_timed_to(system->ac, actor, message, timeout_ns);
+}
+
+timer_id_t cacti_send_after(cacti_system_t *system, actor_id_t actor, message_t message, long delay_ns) {
+    return schedule_to(system->ac, actor, message, delay_ns, 0);
+}
+
+timer_id_t cacti_send_every(cacti_system_t *system, actor_id_t actor, message_t message,
+                            long delay_ns, long period_ns) {
+    return schedule_to(system->ac, actor, message, delay_ns, period_ns > 0 ? period_ns : 1);
+}
+
+int cacti_cancel_timer(cacti_system_t *system, timer_id_t timer) {
+    return cancel_scheduled(system->ac, timer);
+}
+
+future_t cacti_ask(cacti_system_t *system, actor_id_t actor, message_t message) {
+    return ask_to(system, actor, message);
+}
+
+void *cacti_alloc(size_t size) {
+    return slab_alloc(size);
+}
+
+void cacti_free(void *ptr) {
+    slab_free(ptr);
+}
+
+void actor_system_idle_stats(idle_stats_t *stats) {
+    idle_stats(default_system != NULL ? default_system->ac : NULL, stats);
+}
+
+void cacti_system_idle_stats(cacti_system_t *system, idle_stats_t *stats) {
+    idle_stats(system->ac, stats);
+}
+
+void cacti_stats_snapshot(cacti_system_t *system, cacti_stats_t *stats) {
+    if (system == NULL)
+        system = default_system;
+    stats_snapshot(system != NULL ? system->ac : NULL, stats);
+}
+
+void cacti_trace_enable(int on) {
+    atomic_store(&trace_enabled, on);
+}
+
+int cacti_trace_dump(const char *path) {
+#if CACTI_TRACE
+    return trace_dump(path);
+#else
+    (void) path;
+    return -1;
+#endif
+}
+
+size_t cacti_latency_snapshot(cacti_system_t *system, latency_stats_t *stats, size_t n) {
+    if (system == NULL)
+        system = default_system;
+    return latency_snapshot(system != NULL ? system->ac : NULL, stats, n);
+}
@@ -21,6 +21,37 @@ typedef long message_type_t;
 #define POOL_SIZE 3
 #endif
 
+#ifndef ACTOR_QUOTA
+#define ACTOR_QUOTA 16
+#endif
+
+#ifndef ACTOR_URGENT_LIMIT
+#define ACTOR_URGENT_LIMIT 64
+#endif
+
+#ifndef MESSAGE_INLINE_MAX
+#define MESSAGE_INLINE_MAX 64
+#endif
+
+#ifndef COROUTINE_STACK_SIZE
+#define COROUTINE_STACK_SIZE (64 * 1024)
+#endif
+
+/// 0 compiles the runtime counters of cacti_stats_snapshot and actor_stats out
+#ifndef CACTI_STATS
+#define CACTI_STATS 1
+#endif
+
+/// 1 records sends, scheduling, callbacks, spawns, MSG_GODIE and parked workers for cacti_trace_dump
+#ifndef CACTI_TRACE
+#define CACTI_TRACE 0
+#endif
+
+/// 1 records how long messages wait and callbacks run, per role and message type, for cacti_latency_snapshot
+#ifndef CACTI_LATENCY
+#define CACTI_LATENCY 0
+#endif
+
 typedef struct message
 {
     message_type_t message_type;
@@ -28,22 +59,398 @@ typedef struct message
     void *data;
 } message_t;
 
+/// the lower 32 bits pick a slot, the bits above are its generation, bumped each time an actor dies in it
 typedef long actor_id_t;
 
+/// id of a timer of send_message_after or send_message_every, built like actor_id_t
+typedef long timer_id_t;
+
 actor_id_t actor_id_self();
 
+/**
+ * The reply to an ask. Correlation slots are pooled, so asks allocate nothing.
+ * id is negative if the ask has failed, with the codes of send_message.
+ */
+typedef struct future
+{
+    struct cacti_system *system;
+    long id;
+} future_t;
+
 typedef void (*const act_t)(void **stateptr, size_t nbytes, void *data);
 
 typedef struct role
 {
     size_t nprompts;
     act_t *prompts;
+    size_t quota;   ///< messages an actor may process before giving its thread away, 0 for the system's quota
+    int node;       ///< ON_NODE(n) to spawn actors of this role on the workers of NUMA node n, 0 for the spawner's worker
+    const char *dispatcher; ///< name of the dispatcher actors of this role run on, NULL for the default one
+    int coroutine;  ///< 1 to run callbacks on stacks of COROUTINE_STACK_SIZE bytes, where they may call actor_await
 } role_t;
 
+/// value of role_t.node that places actors on NUMA node n, counted from 0 modulo the nodes of the system
+#define ON_NODE(n) ((n) + 1)
+
+#define CPU_MASK_MAX 1024
+
+/// a set of CPUs, CPU i belongs to it if bit i % 64 of cpus[i / 64] is set
+typedef struct cpu_mask
+{
+    unsigned long long cpus[CPU_MASK_MAX / 64];
+} cpu_mask_t;
+
+static inline void cpu_mask_set(cpu_mask_t *mask, int cpu) {
+    mask->cpus[cpu / 64] |= 1ULL << (cpu % 64);
+}
+
+/**
+ * A pool of workers with run queues of its own, next to the default pool of a system.
+ * Actors whose callbacks block, on I/O or sleeps, can run there without holding up
+ * the others. Sending to an actor of another dispatcher costs as much as sending to
+ * one of the same dispatcher, and so does a spawn.
+ */
+typedef struct dispatcher_config
+{
+    const char *name;               ///< unique name roles and spawns refer to the dispatcher by
+    int n_workers;                  ///< threads of the dispatcher, at least 1
+} dispatcher_config_t;
+
+typedef struct actor_system_config
+{
+    size_t quota;                   ///< messages an actor may process before giving its thread away, 0 for ACTOR_QUOTA
+    long quota_ns;                  ///< time an actor may keep its thread while it has messages, in nanoseconds, 0 for no limit
+    int n_workers;                  ///< threads in the pool, 0 for the number of online CPUs
+    const cpu_mask_t *affinity;     ///< n_workers non empty masks, worker i runs only on affinity[i]; NULL to spread
+                                    ///< the workers over NUMA nodes and pin them to their nodes, if there are several
+    size_t stack_size;              ///< stack size of a worker in bytes, 0 for the default
+    size_t mailbox_limit;           ///< messages an actor may have pending, 0 for ACTOR_QUEUE_LIMIT
+    const dispatcher_config_t *dispatchers; ///< n_dispatchers pools besides the default one of n_workers threads,
+                                            ///< pinned to NUMA nodes as the default one when there is no affinity
+    size_t n_dispatchers;
+} actor_system_config_t;
+
+/// how idle workers of a system spent their time, summed over the workers
+typedef struct idle_stats
+{
+    int workers;            ///< number of workers
+    long spin_budget;       ///< polls of the run queues an idle worker makes before it parks
+    long spin_hits;         ///< times an idle worker found work while spinning
+    long parks;             ///< times a worker went to sleep
+    long wakeups;           ///< times a sleeping worker was woken up
+} idle_stats_t;
+
+/// runtime counters of a system, summed over its workers; those that count stay 0 unless CACTI_STATS is set
+typedef struct cacti_stats
+{
+    int workers;            ///< number of workers
+    long sent;              ///< messages accepted into mailboxes
+    long rejected;          ///< sends that got -3, the mailbox was full
+    long processed;         ///< messages taken by workers
+    long activations;       ///< times a worker took an actor to process its messages
+    long busy_ns;           ///< time workers spent on actors, in nanoseconds
+    long idle_ns;           ///< time workers spent looking for actors, parked included
+    long mailbox_high_water;///< most messages an actor had pending when a worker took it
+    long run_queue;         ///< actors waiting for a worker at the moment
+    long alive;             ///< actors alive at the moment
+    idle_stats_t idle;
+} cacti_stats_t;
+
+/// runtime counters of a single actor; processed and high_water stay 0 unless CACTI_STATS is set
+typedef struct actor_stats
+{
+    long processed;         ///< messages taken by workers, counted when a worker lets the actor go
+    long pending;           ///< messages in the mailbox at the moment
+    long high_water;        ///< most messages the actor had pending when a worker took it
+} actor_stats_t;
+
+/// percentiles of a latency histogram in nanoseconds, accurate to an eighth of the value
+typedef struct latency_percentiles
+{
+    long count;             ///< values recorded
+    long p50;
+    long p99;
+    long p999;
+    long max;
+} latency_percentiles_t;
+
+/// latencies of the messages of one type taken by actors of one role
+typedef struct latency_stats
+{
+    const role_t *role;
+    message_type_t message_type;
+    latency_percentiles_t queued;   ///< from the send to the start of the callback
+    latency_percentiles_t waiting;  ///< from the actor becoming runnable to a worker taking it
+    latency_percentiles_t run;      ///< of the callback
+} latency_stats_t;
+
+/**
+ * An independent system of actors with a thread pool of its own. A process may run
+ * several of them at once; ids of actors mean something only within their system.
+ * Functions that take no system act on the system of the calling actor or, called
+ * outside of actors, on the default system, started by actor_system_create.
+ */
+typedef struct cacti_system cacti_system_t;
+
+/// creates the default system with POOL_SIZE threads, with other parameters at their defaults
 int actor_system_create(actor_id_t *actor, role_t *const role);
 
+int actor_system_create_ex(actor_id_t *actor, role_t *const role, const actor_system_config_t *config);
+
+/// waits for all actors of the default system to die and frees the system
 void actor_system_join(actor_id_t actor);
 
+/// idle stats of the default system, or of the last system once it has been joined
+void actor_system_idle_stats(idle_stats_t *stats);
+
+/**
+ * Creates a system next to the running ones, it does not become the default system.
+ * @param[out] actor    - id of the first actor of the system, which gets MSG_HELLO
+ * @return              the system, NULL if it could not be created, also if the dispatchers
+ *                      are invalid or the role names none of them
+ */
+cacti_system_t *cacti_system_create(actor_id_t *actor, role_t *const role, const actor_system_config_t *config);
+
+/// waits for all actors of the system to die and frees the system
+void cacti_system_join(cacti_system_t *system);
+
+/// the system of the calling actor, NULL outside of actors
+cacti_system_t *cacti_system_self();
+
+void cacti_system_idle_stats(cacti_system_t *system, idle_stats_t *stats);
+
+/**
+ * Sums up the counters of the workers of a system while they run. The counters are read
+ * one by one, so they need not add up exactly while the system is busy.
+ * @param system    the system, NULL for the default one or, once it has been joined, the last one
+ */
+void cacti_stats_snapshot(cacti_system_t *system, cacti_stats_t *stats);
+
+/// pauses (0) or resumes (1) recording events, which starts at once if CACTI_TRACE is set
+void cacti_trace_enable(int on);
+
+/**
+ * Writes the events recorded so far, the last few thousand of each thread, to a JSON file
+ * to be opened in chrome://tracing or Perfetto. Threads of joined systems are included.
+ * @return  0 on success, -1 if the file could not be written or CACTI_TRACE is not set
+ */
+int cacti_trace_dump(const char *path);
+
+/**
+ * Merges the latency histograms of the workers of a system while they run.
+ * @param system    the system, NULL for the default one or, once it has been joined, the last one
+ * @param[out] stats    up to n pairs of a role and a message type, in no particular order
+ * @return          the number of pairs recorded so far, 0 if CACTI_LATENCY is not set
+ */
+size_t cacti_latency_snapshot(cacti_system_t *system, latency_stats_t *stats, size_t n);
+
+/**
+ * Sends a message without waiting.
+ * @return  0 on success, -1 if the receiver does not accept messages anymore (or is dead) or the
+ *          system has been interrupted, -2 if there is no such actor, -3 if the receiver's mailbox is full
+ */
 int send_message(actor_id_t actor, message_t message);
 
+/// same as send_message
+int send_message_try(actor_id_t actor, message_t message);
+
+/**
+ * Sends a message that the receiver takes before its ordinary messages; an idle receiver
+ * also runs before actors made runnable by ordinary messages. MSG_GODIE and MSG_SPAWN are
+ * always sent this way, so an actor stops accepting messages as soon as it takes MSG_GODIE,
+ * but still processes those it has accepted. Urgent messages may exceed the mailbox limit
+ * by ACTOR_URGENT_LIMIT.
+ * @return  as send_message
+ */
+int send_message_urgent(actor_id_t actor, message_t message);
+
+/**
+ * Sends a message with nbytes <= MESSAGE_INLINE_MAX bytes of payload copied into the
+ * receiver's mailbox, so it needs no allocation. The callback gets nbytes and a pointer
+ * to the copy as data, valid until the callback returns. message_type may not be MSG_SPAWN.
+ * @return  as send_message, -2 also if nbytes is too big
+ */
+int send_message_inline(actor_id_t actor, message_type_t message_type, const void *payload, size_t nbytes);
+
+/**
+ * Sends a message, waiting up to timeout_ns nanoseconds (forever if negative) for room
+ * in a full mailbox. Called by an actor it does not wait and returns -3 at once.
+ * @return  as send_message
+ */
+int send_message_timed(actor_id_t actor, message_t message, long timeout_ns);
+
+/**
+ * Sends one message to n actors. A payload of nbytes > 0 bytes is copied once into a block
+ * shared by all receivers, which get a pointer to it as data: it may not be modified, and it
+ * is valid until the callback returns, the last receiver frees it. With nbytes 0 the payload
+ * pointer is sent as data, as send_message would. Receivers that become runnable are scheduled
+ * together once all of them have the message. MSG_GODIE and MSG_SPAWN may not have a payload.
+ * @param[out] results  result of the send to each actor as of send_message, may be NULL
+ * @return              number of actors that accepted the message
+ */
+size_t send_multicast(const actor_id_t *actors, size_t n, message_type_t message_type,
+                      const void *payload, size_t nbytes, int *results);
+
+/**
+ * Suspends the calling callback until its actor gets a message of the given type. The worker
+ * runs other actors meanwhile and the callback resumes on whichever worker takes the actor
+ * next. Other messages the actor gets in the meantime are kept, in order, and processed once
+ * the callback returns. Data of a message, the one the callback was called with included,
+ * may be used only until the next actor_await, if it is an inline or multicast payload.
+ * Only for callbacks of roles with coroutine set.
+ * @param[out] message  the awaited message
+ * @return  0 on success, -1 if the actor has taken MSG_GODIE (the callback should return then)
+ *          or the callback is not running on a coroutine
+ */
+int actor_await(message_type_t message_type, message_t *message);
+
+/**
+ * Called by an actor that got -3: asks for a message of the given type, carrying the id
+ * of the full actor as data, once its mailbox has room (or the actor is gone).
+ * @return  0 on success, -1 if not called by an actor, -2 if there is no such actor
+ */
+int notify_on_space(actor_id_t actor, message_type_t message_type);
+
+/**
+ * Sends a message once delay_ns nanoseconds have passed, without blocking anyone meanwhile.
+ * Timers have a resolution of a millisecond and go off at most that late, unless they are
+ * many. The message does not count against the mailbox limit. If the timer is cancelled or
+ * the receiver is gone by then, the message is dropped: data is not freed.
+ * @return  id of the timer, -1 if too many timers are pending, -2 if there is no system
+ */
+timer_id_t send_message_after(actor_id_t actor, message_t message, long delay_ns);
+
+/**
+ * Sends a message after delay_ns nanoseconds and then every period_ns nanoseconds,
+ * until the timer is cancelled or the receiver is gone.
+ * @return  as send_message_after
+ */
+timer_id_t send_message_every(actor_id_t actor, message_t message, long delay_ns, long period_ns);
+
+/**
+ * Cancels a timer of send_message_after or send_message_every, in constant time.
+ * Once it has succeeded, the timer sends nothing more; messages it sent before stay in the mailbox.
+ * @return  0 on success, -1 if the message has been sent (for the last time) or the timer cancelled already
+ */
+int cancel_timer(timer_id_t timer);
+
+/**
+ * Sends a message that expects a reply, in actor_reply. The receiver's callback gets the
+ * message as it was sent and finds the future to reply to in actor_request.
+ * MSG_GODIE and MSG_SPAWN cannot be asked (-2).
+ * @return  the future of the reply, its id is -1 also if FUTURE_LIMIT asks are in flight
+ */
+future_t actor_ask(actor_id_t actor, message_t message);
+
+/// future of the ask the calling callback is processing, its id is -1 if the message is not an ask
+future_t actor_request();
+
+/**
+ * Completes a future. Nothing happens to the reply if it fails.
+ * @return  0 on success, -1 if the future has got a reply already, has been cancelled or is unknown
+ */
+int actor_reply(future_t future, void *reply);
+
+/**
+ * Waits up to timeout_ns nanoseconds (forever if negative) for the reply, for threads outside
+ * of actors; a worker that waits stalls its actors. The future is done with once this succeeds.
+ * @param[out] reply    the reply
+ * @return  0 on success, -1 on timeout (the future may be waited for again or cancelled),
+ *          -2 if the future is unknown, done with or has a continuation
+ */
+int future_wait(future_t future, long timeout_ns, void **reply);
+
+/**
+ * Has the reply sent to the calling actor as a message of the given type, with the reply
+ * as data, instead of waiting for it. The message does not count against the mailbox limit.
+ * @return  0 on success, -1 if not called by an actor, -2 as future_wait
+ */
+int future_then(future_t future, message_type_t message_type);
+
+/**
+ * Gives up a future that will not be waited for, so its slot can be reused once the reply comes.
+ * @return  0 on success, -2 as future_wait
+ */
+int future_cancel(future_t future);
+
+/// send_message to an actor of the given system
+int cacti_send(cacti_system_t *system, actor_id_t actor, message_t message);
+
+/// send_message_urgent to an actor of the given system
+int cacti_send_urgent(cacti_system_t *system, actor_id_t actor, message_t message);
+
+/// send_message_inline to an actor of the given system
+int cacti_send_inline(cacti_system_t *system, actor_id_t actor, message_type_t message_type,
+                      const void *payload, size_t nbytes);
+
+/// send_multicast to actors of the given system
+size_t cacti_send_multicast(cacti_system_t *system, const actor_id_t *actors, size_t n, message_type_t message_type,
+                            const void *payload, size_t nbytes, int *results);
+
+/// send_message_timed to an actor of the given system
+int cacti_send_timed(cacti_system_t *system, actor_id_t actor, message_t message, long timeout_ns);
+
+/// send_message_after to an actor of the given system
+timer_id_t cacti_send_after(cacti_system_t *system, actor_id_t actor, message_t message, long delay_ns);
+
+/// send_message_every to an actor of the given system
+timer_id_t cacti_send_every(cacti_system_t *system, actor_id_t actor, message_t message,
+                            long delay_ns, long period_ns);
+
+/// cancel_timer of a timer of the given system
+int cacti_cancel_timer(cacti_system_t *system, timer_id_t timer);
+
+/// actor_ask to an actor of the given system
+future_t cacti_ask(cacti_system_t *system, actor_id_t actor, message_t message);
+
+/**
+ * Creates an actor at once, unlike MSG_SPAWN. The actor starts with the given state
+ * and gets MSG_HELLO with the id of the calling actor as data, -1 outside of actors.
+ * @return  id of the new actor, -1 if CAST_LIMIT actors are alive already or the system has ended
+ */
+actor_id_t actor_spawn(role_t *const role, void *state);
+
+/**
+ * Creates n actors of the same role as actor_spawn does, reserving their slots at once.
+ * @param states    initial state of each actor, NULL to start all of them with NULL
+ * @param[out] ids  ids of the actors, in the order of states
+ * @return          0 on success, -1 if they do not fit or the system has ended, none is created then
+ */
+int actor_spawn_many(role_t *const role, size_t n, void *const *states, actor_id_t *ids);
+
+/// actor_spawn on the named dispatcher, whichever the role names; -1 also if there is no such dispatcher
+actor_id_t actor_spawn_on(const char *dispatcher, role_t *const role, void *state);
+
+/// actor_spawn in the given system
+actor_id_t cacti_spawn(cacti_system_t *system, role_t *const role, void *state);
+
+/// actor_spawn_many in the given system
+int cacti_spawn_many(cacti_system_t *system, role_t *const role, size_t n, void *const *states, actor_id_t *ids);
+
+/// actor_spawn_on in the given system
+actor_id_t cacti_spawn_on(cacti_system_t *system, const char *dispatcher, role_t *const role, void *state);
+
+/**
+ * An actor sticks to the worker it ran on last, other workers take it over only when
+ * that one is busy with a backlog or a long callback, or sleeps.
+ * @return  times the actor has moved to another worker, -2 if there is no such actor,
+ *          -1 if it is gone
+ */
+long actor_migrations(actor_id_t actor);
+
+/**
+ * Reads the counters of an actor.
+ * @return  0 on success, -2 if there is no such actor, -1 if it is gone
+ */
+int actor_stats(actor_id_t actor, actor_stats_t *stats);
+
+/**
+ * Allocates memory for message payloads and actors' states. Any thread may free it
+ * with cacti_free, which is cheaper than free when the receiver runs on another worker.
+ * Ends the program if there is no memory.
+ */
+void *cacti_alloc(size_t size);
+
+void cacti_free(void *ptr);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,233 @@
+// switches jump between stacks, which the checked longjmp of a fortified build takes for a bug
+#undef _FORTIFY_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+#include "coroutine.h"
+#include "err.h"
+
+/// free coroutines of a thread, only the thread itself uses them
+typedef struct coroutine_cache {
+    coroutine_t *free;
+    int size;
+    int registered;             ///< 1 once the cache is handed over when the thread exits
+} coroutine_cache_t;
+
+static __thread coroutine_t *running = NULL;    ///< coroutine the calling thread runs
+static __thread coroutine_cache_t own_cache = { NULL, 0, 0 };
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;                 ///< gives the cache to the pool when its thread exits
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static coroutine_t *pool = NULL;                ///< coroutines with free stacks, for every thread
+static int pool_size = 0;
+
+static size_t page_size() {
+    static long size = 0;
+
+    if (size == 0 && (size = sysconf(_SC_PAGESIZE)) <= 0)
+        size = 4096;
+
+    return (size_t) size;
+}
+
+/// the first frame of every stack, each coroutine on the stack starts after its _setjmp
+static void trampoline(uint32_t high, uint32_t low) {
+    coroutine_t *co = (coroutine_t*) (((uintptr_t) high << 32) | (uintptr_t) low);
+
+    while (1) {
+        // the thread that resumed the coroutine last gets it back
+        if (_setjmp(co->context) == 0)
+            _longjmp(*co->caller, 1);
+
+        co->prompt(co->stateptr, co->nbytes, co->data);
+        co->returned = 1;
+    }
+}
+
+/// enters a new stack, its trampoline comes back once it is ready for coroutines
+static __attribute__((noinline)) void start_stack(coroutine_t *co) {
+    ucontext_t boot;
+    jmp_buf back;
+    uintptr_t self = (uintptr_t) co;
+
+    if (getcontext(&boot) != 0)
+        syserr(errno, "getcontext failed");
+
+    boot.uc_stack.ss_sp   = co->stack;
+    boot.uc_stack.ss_size = COROUTINE_STACK_SIZE;
+    boot.uc_link          = NULL;
+    makecontext(&boot, (void (*)()) trampoline, 2, (uint32_t) (self >> 32), (uint32_t) self);
+
+    co->caller = &back;
+    if (_setjmp(back) == 0) {
+        setcontext(&boot);
+        syserr(errno, "setcontext failed");
+    }
+}
+
+static coroutine_t* new_coroutine() {
+    size_t guard = page_size();
+    char *memory = mmap(NULL, guard + COROUTINE_STACK_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (memory == MAP_FAILED)
+        syserr(errno, "Out of memory (coroutine stack)");
+
+    // an overflow faults instead of overwriting other memory
+    if (mprotect(memory, guard, PROT_NONE) != 0)
+        syserr(errno, "mprotect failed");
+
+    coroutine_t *co = safe_malloc(sizeof(coroutine_t));
+    co->stack = memory + guard;
+    start_stack(co);
+    return co;
+}
+
+static void free_coroutine(coroutine_t *co) {
+    if (munmap(co->stack - page_size(), page_size() + COROUTINE_STACK_SIZE) != 0)
+        syserr(errno, "munmap failed");
+    free(co);
+}
+
+/// puts a list of coroutines into the pool, those that do not fit are freed
+static void give_back(coroutine_t *list) {
+    coroutine_t *next, *excess = NULL;
+
+    safe_lock(&pool_lock);
+    for (; list != NULL; list = next) {
+        next = list->next_free;
+        if (pool_size < COROUTINE_POOL_MAX) {
+            list->next_free = pool;
+            pool            = list;
+            pool_size++;
+        } else {
+            list->next_free = excess;
+            excess          = list;
+        }
+    }
+    safe_unlock(&pool_lock);
+
+    for (; excess != NULL; excess = next) {
+        next = excess->next_free;
+        free_coroutine(excess);
+    }
+}
+
+static void release_cache(void *cache) {
+    coroutine_cache_t *c = cache;
+    coroutine_t *list = c->free;
+
+    *c = (coroutine_cache_t) { NULL, 0, 0 };
+    give_back(list);
+}
+
+static void create_key() {
+    int err;
+    if ((err = pthread_key_create(&cache_key, release_cache)) != 0)
+        syserr(err, "key create failed");
+}
+
+/// a coroutine from the cache of the thread, refilled from the pool, or a new one
+static coroutine_t* take_coroutine() {
+    coroutine_cache_t *c = &own_cache;
+    coroutine_t *co;
+
+    // half of what the cache holds at most, the other half is left for coroutines given back
+    if (c->free == NULL) {
+        safe_lock(&pool_lock);
+        while (pool != NULL && c->size < COROUTINE_CACHE_MAX / 2) {
+            co            = pool;
+            pool          = pool->next_free;
+            co->next_free = c->free;
+            c->free       = co;
+            c->size++;
+            pool_size--;
+        }
+        safe_unlock(&pool_lock);
+    }
+
+    if ((co = c->free) == NULL)
+        return new_coroutine();
+
+    c->free = co->next_free;
+    c->size--;
+    return co;
+}
+
+coroutine_t* coroutine_create(act_t prompt, void **stateptr, size_t nbytes, void *data, void *owner) {
+    coroutine_t *co = take_coroutine();
+
+    co->caller   = NULL;
+    co->returned = 0;
+    co->prompt   = prompt;
+    co->stateptr = stateptr;
+    co->nbytes   = nbytes;
+    co->data     = data;
+    co->owner    = owner;
+
+    return co;
+}
+
+int coroutine_resume(coroutine_t *co) {
+    jmp_buf caller;
+    coroutine_t *outer = running;
+
+    co->caller = &caller;
+    running    = co;
+
+    if (_setjmp(caller) == 0)
+        _longjmp(co->context, 1);
+
+    running = outer;
+    return co->returned;
+}
+
+void coroutine_yield() {
+    coroutine_t *co = running;
+
+    if (co == NULL)
+        fatal("coroutine_yield outside of coroutines");
+
+    // may come back on another thread, nothing thread local is used after the switch
+    if (_setjmp(co->context) == 0)
+        _longjmp(*co->caller, 1);
+}
+
+coroutine_t* coroutine_self() {
+    return running;
+}
+
+void coroutine_destroy(coroutine_t *co) {
+    coroutine_cache_t *c = &own_cache;
+    coroutine_t *list, *last;
+    int err, i;
+
+    if (!c->registered) {
+        if ((err = pthread_once(&key_once, create_key)) != 0)
+            syserr(err, "once failed");
+        if ((err = pthread_setspecific(cache_key, c)) != 0)
+            syserr(err, "setspecific failed");
+        c->registered = 1;
+    }
+
+    co->next_free = c->free;
+    c->free       = co;
+    if (++c->size <= COROUTINE_CACHE_MAX)
+        return;
+
+    // a full cache passes half of its coroutines to the pool at once
+    list = last = c->free;
+    for (i = 1; i < COROUTINE_CACHE_MAX / 2; ++i)
+        last = last->next_free;
+    c->free         = last->next_free;
+    last->next_free = NULL;
+    c->size        -= COROUTINE_CACHE_MAX / 2;
+
+    give_back(list);
+}
@@ -0,0 +1,54 @@
+// Stackful coroutines that run callbacks and may be suspended in the middle of them.
+//
+// A coroutine runs on a stack of its own. Every stack is entered once through ucontext,
+// later switches use _setjmp and _longjmp, which leave the signal mask alone and so make
+// no system calls. A coroutine may be resumed by another thread than the one that
+// suspended it. Stacks are given back when their callbacks return: every thread keeps
+// up to COROUTINE_CACHE_MAX of them for itself and passes the rest to a shared pool of
+// at most COROUTINE_POOL_MAX, so memory grows only with the number of coroutines
+// suspended at once.
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <setjmp.h>
+
+#include "cacti.h"
+
+#define COROUTINE_POOL_MAX 256  ///< free stacks shared by all threads
+#define COROUTINE_CACHE_MAX 16  ///< free stacks a thread keeps for itself
+
+typedef struct coroutine {
+    jmp_buf context;            ///< where the coroutine goes on when resumed
+    jmp_buf *caller;            ///< where it goes back to when it yields or returns
+    char *stack;                ///< COROUTINE_STACK_SIZE bytes above a guard page
+    int returned;               ///< 1 once the callback has returned
+    void (*prompt)(void **stateptr, size_t nbytes, void *data); ///< the callback and its arguments
+    void **stateptr;
+    size_t nbytes;
+    void *data;
+    void *owner;                ///< whatever the creator has associated with the coroutine
+    struct coroutine *next_free;
+} coroutine_t;
+
+/**
+ * Prepares a coroutine that will call prompt(stateptr, nbytes, data) when first resumed.
+ */
+extern coroutine_t* coroutine_create(act_t prompt, void **stateptr, size_t nbytes, void *data, void *owner);
+
+/**
+ * Runs the coroutine on the calling thread until it yields or its callback returns.
+ * @return      1 if the callback has returned, 0 if the coroutine has yielded
+ */
+extern int coroutine_resume(coroutine_t *co);
+
+/// suspends the calling coroutine, its coroutine_resume returns 0
+extern void coroutine_yield();
+
+/// the coroutine running on the calling thread, NULL if there is none
+extern coroutine_t* coroutine_self();
+
+/// gives the stack of a coroutine back to the pool, the coroutine may not be resumed anymore
+extern void coroutine_destroy(coroutine_t *co);
+
+#endif //COROUTINE_H
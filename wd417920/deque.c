@@ -0,0 +1,99 @@
+#include <stdlib.h>
+
+#include "deque.h"
+#include "err.h"
+
+// Based on "Correct and Efficient Work-Stealing for Weak Memory Models"
+// (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013).
+
+static deque_buffer_t* buffer_init(long capacity) {
+    deque_buffer_t *b = safe_malloc(sizeof(deque_buffer_t) + capacity * sizeof(_Atomic actor_id_t));
+    b->capacity = capacity;
+    b->retired  = NULL;
+    return b;
+}
+
+static inline actor_id_t buffer_get(deque_buffer_t *b, long i) {
+    return atomic_load_explicit(&b->items[i & (b->capacity - 1)], memory_order_relaxed);
+}
+
+static inline void buffer_put(deque_buffer_t *b, long i, actor_id_t id) {
+    atomic_store_explicit(&b->items[i & (b->capacity - 1)], id, memory_order_relaxed);
+}
+
+/**
+ * Replaces a full buffer with one twice as big. The old buffer may still be read
+ * by thieves, so it is only unlinked and freed together with the deque.
+ */
+static deque_buffer_t* buffer_grow(deque_t *d, deque_buffer_t *old, long top, long bottom) {
+    long i;
+    deque_buffer_t *b = buffer_init(old->capacity * 2);
+
+    for (i = top; i < bottom; ++i)
+        buffer_put(b, i, buffer_get(old, i));
+
+    b->retired = old;
+    atomic_store_explicit(&d->buffer, b, memory_order_release);
+    return b;
+}
+
+deque_t* deque_init() {
+    deque_t *d = safe_aligned_malloc(sizeof(deque_t));
+
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    atomic_init(&d->buffer, buffer_init(DEQUE_INITIAL_CAPACITY));
+
+    return d;
+}
+
+void deque_push(deque_t *d, actor_id_t id) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    deque_buffer_t *buf = atomic_load_explicit(&d->buffer, memory_order_relaxed);
+
+    if (b - t > buf->capacity - 1)
+        buf = buffer_grow(d, buf, t, b);
+
+    buffer_put(buf, b, id);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+int deque_steal(deque_t *d, actor_id_t *id) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    if (t >= b)
+        return -1;
+
+    deque_buffer_t *buf = atomic_load_explicit(&d->buffer, memory_order_consume);
+    actor_id_t res = buffer_get(buf, t);
+
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed))
+        return -2;
+
+    *id = res;
+    return 0;
+}
+
+long deque_size(deque_t *d) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    return b > t ? b - t : 0;
+}
+
+int deque_destroy(deque_t *d) {
+    deque_buffer_t *buf = atomic_load(&d->buffer), *next;
+
+    while (buf != NULL) {
+        next = buf->retired;
+        free(buf);
+        buf = next;
+    }
+
+    free(d);
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Work-stealing deque (Chase-Lev). The owner pushes at the bottom, every thread,
+// the owner included, takes from the top, so actors run in the order they were pushed.
+
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include <stdatomic.h>
+
+#include "cacti.h"
+#include "err.h"
+
+#define DEQUE_INITIAL_CAPACITY 256
+
+typedef struct deque_buffer {
+    long capacity;                       ///< always a power of two
+    struct deque_buffer *retired;        ///< smaller buffer this one replaced, freed in deque_destroy
+    _Atomic actor_id_t items[];
+} deque_buffer_t;
+
+typedef struct deque {
+    _Alignas(CACHE_LINE) atomic_long top;                ///< next element to be stolen
+    _Alignas(CACHE_LINE) atomic_long bottom;             ///< next free slot of the owner
+    _Atomic(deque_buffer_t*) buffer;
+} deque_t;
+
+extern deque_t* deque_init();
+
+/**
+ * Pushes an element at the bottom. May be called only by the owner.
+ */
+extern void deque_push(deque_t *d, actor_id_t id);
+
+/**
+ * Takes an element from the top. May be called by any thread.
+ * @return      0 on success, -1 if the deque is empty, -2 if the race with another thief was lost
+ */
+extern int deque_steal(deque_t *d, actor_id_t *id);
+
+/// approximate number of elements, may be called by any thread
+extern long deque_size(deque_t *d);
+
+extern int deque_destroy(deque_t *d);
+
+#endif //DEQUE_H
@@ -37,4 +37,15 @@ void* safe_malloc_help(int n, int line) {
         exit(1);
     }
     return p;
-}
\ No newline at end of file
+}
+
+void* safe_aligned_malloc_help(size_t n, int line) {
+    void* p = NULL;
+    int err;
+    if ((err = posix_memalign(&p, CACHE_LINE, n)) != 0) {
+        fprintf(stderr, "[%s:%d] Out of memory (%zu bytes)\n",
+                __FILE__, line, n);
+        exit(1);
+    }
+    return p;
+}
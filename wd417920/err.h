@@ -15,6 +15,13 @@ extern void* safe_malloc_help(int n, int line);
 
 #define safe_malloc(n) safe_malloc_help(n, __LINE__)
 
+#define CACHE_LINE 64
+
+/* pamiec wyrownana do linii cache, zwalniana przez free */
+extern void* safe_aligned_malloc_help(size_t n, int line);
+
+#define safe_aligned_malloc(n) safe_aligned_malloc_help(n, __LINE__)
+
 static inline void safe_lock(pthread_mutex_t *mutex) {
     int err;
     if ((err = pthread_mutex_lock(mutex)) != 0)
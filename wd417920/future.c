@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "future.h"
+#include "err.h"
+
+#define ID_INDEX     0xffffffffL    ///< bits of a future id holding its slot, the bits above hold its generation
+#define NO_FREE_SLOT 0xffffffffL    ///< index of the top of an empty free list
+#define STATE        0xffffffffL    ///< bits of future_slot_t.word holding the state
+
+static inline uint64_t word_of(long id, uint64_t state) {
+    return (uint64_t) (id >> 32) << 32 | state;
+}
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+future_pool_t* future_pool_init() {
+    future_pool_t *p = safe_malloc(sizeof(future_pool_t));
+
+    p->slots = actor_table_init(sizeof(future_slot_t), FUTURE_LIMIT);
+    atomic_init(&p->free, NO_FREE_SLOT);
+    return p;
+}
+
+/// the slot of a future, NULL if the id is incorrect
+static future_slot_t* find_slot(future_pool_t *p, long id) {
+    if (id < 0 || (id & ID_INDEX) >= actor_table_size(p->slots))
+        return NULL;
+
+    return actor_table_get(p->slots, id & ID_INDEX);
+}
+
+/// bumps the generation of a slot, whose future is done, and puts it on the free list
+static void release_slot(future_pool_t *p, long id, future_slot_t *slot) {
+    uint64_t next, head = atomic_load(&p->free);
+
+    atomic_store(&slot->word, word_of(id + (1L << 32), 0) & 0x7fffffffffffffffUL);
+
+    do {
+        atomic_store(&slot->next_free, (long) (head & ID_INDEX));
+        next = ((head >> 32) + 1) << 32 | (uint64_t) (id & ID_INDEX);
+    } while (!atomic_compare_exchange_weak(&p->free, &head, next));
+}
+
+long future_acquire(future_pool_t *p) {
+    future_slot_t *slot;
+    long index;
+    uint64_t next, head = atomic_load(&p->free);
+
+    do {
+        if ((head & ID_INDEX) == NO_FREE_SLOT) {
+            if ((index = actor_table_reserve(p->slots, 1)) < 0)
+                return -1;
+            slot = actor_table_get(p->slots, index);
+            atomic_store(&slot->word, FUTURE_PENDING); // generation 0 in a new slot
+            return index;
+        }
+
+        slot = actor_table_get(p->slots, head & ID_INDEX);
+        next = ((head >> 32) + 1) << 32 | (uint64_t) atomic_load(&slot->next_free);
+    } while (!atomic_compare_exchange_weak(&p->free, &head, next));
+
+    uint64_t word = atomic_load(&slot->word);
+    atomic_store(&slot->word, word | FUTURE_PENDING);
+    return (long) (word >> 32) << 32 | (long) (head & ID_INDEX);
+}
+
+void future_release(future_pool_t *p, long id) {
+    release_slot(p, id, find_slot(p, id));
+}
+
+int future_complete(future_pool_t *p, long id, void *reply, future_continuation_t *then) {
+    future_slot_t *slot = find_slot(p, id);
+    uint64_t word;
+
+    if (slot == NULL)
+        return -1;
+
+    // only one reply gets past this point
+    word = word_of(id, FUTURE_PENDING);
+    if (atomic_compare_exchange_strong(&slot->word, &word, word_of(id, FUTURE_REPLYING))) {
+        slot->reply = reply;
+        atomic_store(&slot->word, word_of(id, FUTURE_REPLIED));
+        atomic_fetch_add(&slot->replies, 1);
+        syscall(SYS_futex, &slot->replies, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+        return 0;
+    }
+
+    if (word == word_of(id, FUTURE_THEN)
+            && atomic_compare_exchange_strong(&slot->word, &word, word_of(id, FUTURE_REPLIED))) {
+        *then = (future_continuation_t) {
+            .system = slot->then_system, .actor = slot->then_actor, .message_type = slot->then_type,
+            .reply = reply
+        };
+        release_slot(p, id, slot);
+        return 1;
+    }
+
+    if (word == word_of(id, FUTURE_CANCELLED)
+            && atomic_compare_exchange_strong(&slot->word, &word, word_of(id, FUTURE_REPLIED)))
+        release_slot(p, id, slot);
+
+    return -1;
+}
+
+int future_take(future_pool_t *p, long id, long timeout_ns, void **reply) {
+    future_slot_t *slot = find_slot(p, id);
+    long deadline = timeout_ns >= 0 ? now_ns() + timeout_ns : 0, left = 0;
+    struct timespec ts;
+
+    if (slot == NULL)
+        return -2;
+
+    for (;;) {
+        unsigned int replies = atomic_load(&slot->replies); // a reply after this makes the wait return at once
+        uint64_t word = atomic_load(&slot->word);
+
+        if (word == word_of(id, FUTURE_REPLIED)) {
+            *reply = slot->reply;
+            release_slot(p, id, slot);
+            return 0;
+        }
+        if (word != word_of(id, FUTURE_PENDING) && word != word_of(id, FUTURE_REPLYING))
+            return -2;
+
+        if (timeout_ns >= 0 && (left = deadline - now_ns()) <= 0)
+            return -1;
+
+        ts.tv_sec  = left / 1000000000L;
+        ts.tv_nsec = left % 1000000000L;
+        syscall(SYS_futex, &slot->replies, FUTEX_WAIT_PRIVATE, replies, timeout_ns >= 0 ? &ts : NULL, NULL, 0);
+    }
+}
+
+int future_continue(future_pool_t *p, long id, void *system, actor_id_t actor,
+                    message_type_t message_type, future_continuation_t *now) {
+    future_slot_t *slot = find_slot(p, id);
+    uint64_t word = word_of(id, FUTURE_PENDING);
+
+    // the fields below belong to whoever holds the current generation
+    if (slot == NULL || atomic_load(&slot->word) >> 32 != (uint64_t) id >> 32)
+        return -2;
+
+    slot->then_system = system;
+    slot->then_actor  = actor;
+    slot->then_type   = message_type;
+
+    while (!atomic_compare_exchange_weak(&slot->word, &word, word_of(id, FUTURE_THEN))) {
+        if (word == word_of(id, FUTURE_REPLYING)) // the reply is almost there
+            word = word_of(id, FUTURE_PENDING);
+        else if (word == word_of(id, FUTURE_REPLIED))
+            break;
+        else if (word != word_of(id, FUTURE_PENDING))
+            return -2;
+    }
+
+    if (word != word_of(id, FUTURE_REPLIED))
+        return 0;
+
+    *now = (future_continuation_t) {
+        .system = system, .actor = actor, .message_type = message_type, .reply = slot->reply
+    };
+    release_slot(p, id, slot);
+    return 1;
+}
+
+int future_abandon(future_pool_t *p, long id) {
+    future_slot_t *slot = find_slot(p, id);
+    uint64_t word;
+
+    if (slot == NULL)
+        return -2;
+
+    for (word = atomic_load(&slot->word); ; ) {
+        if (word == word_of(id, FUTURE_REPLIED)) {
+            release_slot(p, id, slot);
+            return 0;
+        }
+        if (word == word_of(id, FUTURE_REPLYING)) { // the reply is almost there
+            word = atomic_load(&slot->word);
+            continue;
+        }
+        if (word != word_of(id, FUTURE_PENDING) && word != word_of(id, FUTURE_THEN))
+            return -2;
+        if (atomic_compare_exchange_weak(&slot->word, &word, word_of(id, FUTURE_CANCELLED)))
+            return 0;
+    }
+}
+
+void future_pool_destroy(future_pool_t *p) {
+    actor_table_destroy(p->slots);
+    free(p);
+}
@@ -0,0 +1,92 @@
+// Correlation slots of asks, matching replies to the futures that wait for them.
+//
+// Slots live in a table and go back to a lock-free free list once the asker has
+// taken the reply (or given up), so asks allocate nothing once the table has grown
+// to the number of asks in flight. A slot's generation is bumped when it is freed:
+// replies to, and waits for, futures of earlier generations fail.
+
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "cacti.h"
+#include "actor_table.h"
+
+#define FUTURE_LIMIT 0x7fffffffL    ///< asks in flight at once
+
+#define FUTURE_PENDING   1  ///< waits for the reply, nobody has said how it is to be taken
+#define FUTURE_THEN      2  ///< waits for the reply, which goes to a continuation
+#define FUTURE_REPLIED   3  ///< the reply waits to be taken
+#define FUTURE_CANCELLED 4  ///< the asker has given up, the reply frees the slot
+#define FUTURE_REPLYING  5  ///< the reply is being stored, for a moment
+
+typedef struct future_slot {
+    _Atomic uint64_t word;          ///< generation in the upper half, state in the lower one
+    atomic_uint replies;            ///< futex waiters sleep on, bumped by the reply
+    void *reply;                    ///< set by the reply that has moved the state to FUTURE_REPLYING
+    void *then_system;              ///< continuation: whatever the caller of future_continue passed
+    actor_id_t then_actor;
+    message_type_t then_type;
+    atomic_long next_free;          ///< next slot of the free list while the slot is unused
+} future_slot_t;
+
+typedef struct future_pool {
+    actor_table_t *slots;
+    _Atomic uint64_t free;          ///< free list: ABA tag in the upper half, index of the top in the lower one
+} future_pool_t;
+
+/// a continuation future_complete or future_continue asks the caller to run, the slot is free already
+typedef struct future_continuation {
+    void *system;
+    actor_id_t actor;
+    message_type_t message_type;
+    void *reply;
+} future_continuation_t;
+
+extern future_pool_t* future_pool_init();
+
+/**
+ * Takes a slot for a new ask.
+ * @return      id of the future, -1 if FUTURE_LIMIT asks are in flight
+ */
+extern long future_acquire(future_pool_t *p);
+
+/// frees the slot of a future nobody has heard of, because its ask could not be sent
+extern void future_release(future_pool_t *p, long id);
+
+/**
+ * Completes a future.
+ * @param[out] then     the continuation to run, if the function returns 1
+ * @return              0 on success, 1 if a continuation has to be run, -1 if the future is unknown,
+ *                      has been completed already or its asker has given up
+ */
+extern int future_complete(future_pool_t *p, long id, void *reply, future_continuation_t *then);
+
+/**
+ * Waits for the reply, up to timeout_ns nanoseconds (forever if negative), and frees the slot.
+ * @param[out] reply    the reply
+ * @return              0 on success, -1 on timeout (the future still waits), -2 if the future is unknown
+ *                      or has a continuation
+ */
+extern int future_take(future_pool_t *p, long id, long timeout_ns, void **reply);
+
+/**
+ * Has the reply delivered to an actor as a message of the given type.
+ * @param[out] now      the continuation to run at once, if the function returns 1
+ * @return              0 on success, 1 if the reply is there already, -2 if the future is unknown
+ *                      or has a continuation already
+ */
+extern int future_continue(future_pool_t *p, long id, void *system, actor_id_t actor,
+                           message_type_t message_type, future_continuation_t *now);
+
+/**
+ * Gives a future up, a later reply fails.
+ * @return              0 on success, -2 if the future is unknown
+ */
+extern int future_abandon(future_pool_t *p, long id);
+
+extern void future_pool_destroy(future_pool_t *p);
+
+#endif //FUTURE_H
@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "latency.h"
+#include "err.h"
+
+static inline int bucket_of(long value) {
+    if (value < LATENCY_SUB)
+        return (int) value;
+
+    int shift = 63 - __builtin_clzl(value) - LATENCY_SUB_BITS;
+    return (shift + 1) * LATENCY_SUB + (int) ((value >> shift) & (LATENCY_SUB - 1));
+}
+
+/// the highest value that falls into a bucket
+static inline long highest_of(int bucket) {
+    if (bucket < LATENCY_SUB)
+        return bucket;
+
+    int shift = bucket / LATENCY_SUB - 1;
+    return ((long) (LATENCY_SUB + bucket % LATENCY_SUB) << shift) + (1L << shift) - 1;
+}
+
+static inline size_t slot_of(const role_t *role, message_type_t message_type) {
+    uint64_t h = (uint64_t) (uintptr_t) role * 0x9e3779b97f4a7c15UL ^ (uint64_t) message_type * 0xc2b2ae3d27d4eb4fUL;
+    return (size_t) (h >> 32) & (LATENCY_KEYS - 1);
+}
+
+/// adds n to a counter only the calling thread writes to
+static inline void add(atomic_long *counter, long n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static void record(latency_histogram_t *h, long value) {
+    if (value < 0)
+        return;
+
+    add(&h->buckets[bucket_of(value)], 1);
+    add(&h->count, 1);
+    if (value > atomic_load_explicit(&h->max, memory_order_relaxed))
+        atomic_store_explicit(&h->max, value, memory_order_relaxed);
+}
+
+static void merge(latency_histogram_t *into, latency_histogram_t *from) {
+    int i;
+    long max = atomic_load_explicit(&from->max, memory_order_relaxed);
+
+    for (i = 0; i < LATENCY_BUCKETS; ++i) {
+        long n = atomic_load_explicit(&from->buckets[i], memory_order_relaxed);
+        add(&into->buckets[i], n);
+        add(&into->count, n);
+    }
+    if (max > atomic_load_explicit(&into->max, memory_order_relaxed))
+        atomic_store_explicit(&into->max, max, memory_order_relaxed);
+}
+
+/**
+ * The entry of a pair, inserted if it is not there and the caller owns the table.
+ * @return      the entry, NULL if the table is full
+ */
+static latency_entry_t* find_entry(latency_table_t *t, const role_t *role, message_type_t message_type) {
+    size_t i, slot = slot_of(role, message_type);
+    latency_entry_t *e;
+
+    for (i = 0; i < LATENCY_KEYS; ++i, slot = (slot + 1) & (LATENCY_KEYS - 1)) {
+        e = atomic_load_explicit(&t->entries[slot], memory_order_acquire);
+
+        if (e == NULL) {
+            e = safe_malloc(sizeof(latency_entry_t));
+            memset(e, 0, sizeof(latency_entry_t));
+            e->role         = role;
+            e->message_type = message_type;
+            atomic_store_explicit(&t->entries[slot], e, memory_order_release);
+            return e;
+        }
+
+        if (e->role == role && e->message_type == message_type)
+            return e;
+    }
+
+    return NULL;
+}
+
+latency_table_t* latency_table_init() {
+    latency_table_t *t = safe_malloc(sizeof(latency_table_t));
+    memset(t, 0, sizeof(latency_table_t));
+    return t;
+}
+
+void latency_record(latency_table_t *t, const role_t *role, message_type_t message_type,
+                    long queued, long waiting, long run) {
+    latency_entry_t *e = find_entry(t, role, message_type);
+
+    if (e == NULL) {
+        add(&t->dropped, 1);
+        return;
+    }
+
+    record(&e->queued, queued);
+    record(&e->waiting, waiting);
+    record(&e->run, run);
+}
+
+void latency_merge(latency_table_t *into, latency_table_t *from) {
+    int i;
+    latency_entry_t *e, *to;
+
+    for (i = 0; i < LATENCY_KEYS; ++i) {
+        if ((e = atomic_load_explicit(&from->entries[i], memory_order_acquire)) == NULL)
+            continue;
+
+        if ((to = find_entry(into, e->role, e->message_type)) == NULL) {
+            add(&into->dropped, atomic_load_explicit(&e->run.count, memory_order_relaxed));
+            continue;
+        }
+
+        merge(&to->queued, &e->queued);
+        merge(&to->waiting, &e->waiting);
+        merge(&to->run, &e->run);
+    }
+
+    add(&into->dropped, atomic_load_explicit(&from->dropped, memory_order_relaxed));
+}
+
+/// the value below which a fraction q of the recorded values lie, to within a sub-bucket
+static long percentile(latency_histogram_t *h, long count, double q) {
+    int i;
+    long seen = 0, rank = (long) (q * count + 0.5);
+    long max = atomic_load_explicit(&h->max, memory_order_relaxed);
+
+    if (rank < 1)
+        rank = 1;
+
+    for (i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (seen >= rank)
+            return highest_of(i) < max ? highest_of(i) : max;
+    }
+
+    return max;
+}
+
+static latency_percentiles_t percentiles(latency_histogram_t *h) {
+    long count = atomic_load_explicit(&h->count, memory_order_relaxed);
+
+    if (count == 0)
+        return (latency_percentiles_t) { 0 };
+
+    return (latency_percentiles_t) {
+            .count = count,
+            .p50   = percentile(h, count, 0.5),
+            .p99   = percentile(h, count, 0.99),
+            .p999  = percentile(h, count, 0.999),
+            .max   = atomic_load_explicit(&h->max, memory_order_relaxed)
+    };
+}
+
+size_t latency_export(latency_table_t *t, latency_stats_t *stats, size_t n) {
+    int i;
+    size_t found = 0;
+    latency_entry_t *e;
+
+    for (i = 0; i < LATENCY_KEYS; ++i) {
+        if ((e = atomic_load_explicit(&t->entries[i], memory_order_acquire)) == NULL)
+            continue;
+
+        if (found < n) {
+            stats[found] = (latency_stats_t) {
+                    .role         = e->role,
+                    .message_type = e->message_type,
+                    .queued       = percentiles(&e->queued),
+                    .waiting      = percentiles(&e->waiting),
+                    .run          = percentiles(&e->run)
+            };
+        }
+        ++found;
+    }
+
+    return found;
+}
+
+void latency_table_destroy(latency_table_t *t) {
+    int i;
+
+    for (i = 0; i < LATENCY_KEYS; ++i)
+        free(atomic_load(&t->entries[i]));
+    free(t);
+}
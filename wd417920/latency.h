@@ -0,0 +1,59 @@
+// Latency histograms per role and message type.
+//
+// Histograms are log-bucketed as HDR histograms are: a bucket per power of two, split
+// into LATENCY_SUB linear sub-buckets, so a value is known to within 1 / LATENCY_SUB
+// of itself whatever its magnitude. Every worker keeps a table of its own, only the
+// owner inserts and adds; readers merge the tables while they change.
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdatomic.h>
+
+#include "cacti.h"
+
+#define LATENCY_SUB_BITS 3
+#define LATENCY_SUB (1 << LATENCY_SUB_BITS)                 ///< sub-buckets of a power of two
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS) * LATENCY_SUB)
+#define LATENCY_KEYS 128                                    ///< pairs of a role and a message type a table holds
+
+typedef struct latency_histogram {
+    atomic_long buckets[LATENCY_BUCKETS];
+    atomic_long count;
+    atomic_long max;
+} latency_histogram_t;
+
+typedef struct latency_entry {
+    const role_t *role;
+    message_type_t message_type;
+    latency_histogram_t queued;     ///< from the send to the callback
+    latency_histogram_t waiting;    ///< from the actor becoming runnable to a worker taking it
+    latency_histogram_t run;        ///< of the callback
+} latency_entry_t;
+
+typedef struct latency_table {
+    latency_entry_t* _Atomic entries[LATENCY_KEYS];     ///< open addressing, published once filled
+    atomic_long dropped;                                ///< records that found the table full
+} latency_table_t;
+
+extern latency_table_t* latency_table_init();
+
+/**
+ * Adds a record of a callback, may be called only by the owner of the table.
+ * @param queued, waiting, run  - nanoseconds, negative if not known
+ */
+extern void latency_record(latency_table_t *t, const role_t *role, message_type_t message_type,
+                           long queued, long waiting, long run);
+
+/// adds the histograms of a table that may be changing to a table nobody else uses
+extern void latency_merge(latency_table_t *into, latency_table_t *from);
+
+/**
+ * @param[out] stats    percentiles of up to n pairs of a role and a message type
+ * @return              the number of pairs in the table
+ */
+extern size_t latency_export(latency_table_t *t, latency_stats_t *stats, size_t n);
+
+extern void latency_table_destroy(latency_table_t *t);
+
+#endif //LATENCY_H
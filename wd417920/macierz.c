@@ -1,6 +1,5 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
 
 #include "cacti.h"
 #include "err.h"
@@ -8,11 +7,9 @@
 #define UNUSED_PARAMETER(x) (void)(x)
 
 #define MSG_INIT     (message_type_t)0x1
-#define MSG_HI_BACK  (message_type_t)0x2
-#define MSG_READY    (message_type_t)0x3
-#define MSG_SETSTATE (message_type_t)0x4
-#define MSG_COMPUTE  (message_type_t)0x5
-#define MSG_FREE     (message_type_t)0x6
+#define MSG_COMPUTE  (message_type_t)0x2
+#define MSG_FREE     (message_type_t)0x3
+#define MSG_DONE     (message_type_t)0x4
 
 
 
@@ -26,9 +23,8 @@ typedef struct actor_state {
     int n_rows;
     volatile int *result;        // used only by first actor
     role_t *role;                // used only by first actor
-    int column_helper;           // used only by first actor
-    int n_actors_ready;          // used only by first actor
     int n_rows_counted;          // used only by first actor
+    actor_id_t *children;        // used only by first actor
 } actor_state_t;
 
 typedef struct partial {
@@ -36,36 +32,8 @@ typedef struct partial {
     int row;
 } partial_t;
 
-/** Called when an actor receives HELLO message
- *
- * @param stateptr      a pointer to NULL. Function changes NULL to pointer to actor's state
- * @param nbytes        irrelevant
- * @param data          actor_id_t of parent actor
- */
-void callback_hello(void **stateptr, size_t nbytes, void *data) {
-    UNUSED_PARAMETER(stateptr);
-    UNUSED_PARAMETER(nbytes);
-
-    int err;
-    actor_id_t parent = (actor_id_t) data;
-
-#ifdef DEBUG
-    fprintf (stdout, "SEND HIBACK : %ld \n", actor_id_self());
-#endif
-
-    message_t message_hi_back = {
-            .message_type = MSG_HI_BACK,
-            .nbytes = 0, // irrelevant
-            .data = (void*) actor_id_self()
-    };
-
-    if ((err = send_message(parent, message_hi_back)) != 0) {
-        syserr(err, "send_message HI_BACK failed");
-    }
-
-}
-
-/** An initial call to the first actor in system
+/** An initial call to the first actor in system, spawns the other columns
+ *  and starts the computation
  *
  * @param stateptr  pointer to NULL
  * @param nbytes    irrelevant
@@ -77,137 +45,55 @@ void callback_init(void **stateptr, size_t nbytes, void *data) {
     int err, i;
     *stateptr = data;
 
-    actor_state_t state = **(actor_state_t**) stateptr;
-
-    for (i = 0; i < state.n_actors_system - 1; ++i) {
-        message_t message_spawn = {
-                .message_type = MSG_SPAWN,
-                .nbytes = 0, // irrelevant
-                .data = (void*) state.role
-        };
-
-        if ((err = send_message(actor_id_self(), message_spawn)) != 0) {
-            syserr(err, "send_message SPAWN failed");
-        }
-
-    }
-
-}
-
-/** Called when the first actor in system receives HI_BACK message
- *
- * @param stateptr  state of actor (actor_state_t**)
- * @param nbytes    irrelevent
- * @param data      actor_id_t of calling actor
- */
-void callback_hi_back(void **stateptr, size_t nbytes, void *data) {
-    UNUSED_PARAMETER(nbytes);
-
-    int err;
-    actor_id_t child = (actor_id_t) data;
-
-#ifdef DEBUG
-    fprintf(stdout, "HIBACK %ld\n", child);
-#endif
-
     actor_state_t *state = *stateptr;
-    actor_state_t *child_state = safe_malloc(sizeof(actor_state_t));
-    *child_state = *state; // shallow copy
-
-    state->actor_id_prev = child;
-
-    state->column_helper--;
-    child_state->column_number = state->column_helper;
-
-    message_t message_setstate = {
-            .message_type   = MSG_SETSTATE,
-            .data           = child_state
-    };
-
-    if ((err = send_message(child, message_setstate)) != 0) {
-        syserr(err, "send_message SETSTATE failed");
+    int n_children = state->n_actors_system - 1;
+    actor_state_t **child_states = cacti_alloc((n_children + 1) * sizeof(actor_state_t*));
+    actor_id_t *children = cacti_alloc((n_children + 1) * sizeof(actor_id_t));
+
+    // child i takes column n - 2 - i
+    for (i = 0; i < n_children; ++i) {
+        child_states[i] = cacti_alloc(sizeof(actor_state_t));
+        *child_states[i] = *state; // shallow copy
+        child_states[i]->column_number = n_children - 1 - i;
     }
-}
 
+    if (actor_spawn_many(state->role, n_children, (void *const *) child_states, children) != 0) {
+        fatal("actor_spawn_many failed");
+    }
 
-/** Called when the first actor in system receives READY message
- *
- * @param stateptr  state of actor (actor_state_t**)
- * @param nbytes    irrelevent
- * @param data      actor_id_t of calling actor
- */
-void callback_ready(void **stateptr, size_t nbytes, void *data) {
-    UNUSED_PARAMETER(nbytes);
-    UNUSED_PARAMETER(data);
-
-    int err, i;
-    actor_state_t *state = *stateptr;
-    state->n_actors_ready++;
-
-    // start actual computation when all actors initialized
-    if (state->n_actors_ready != state->n_actors_system) {
-        return;
+    // every column passes partial results to the next one; the children read their
+    // successors only in MSG_COMPUTE, which is sent after this
+    for (i = 0; i < n_children; ++i) {
+        child_states[i]->actor_id_prev = i == 0 ? state->actor_id_first : children[i - 1];
+    }
+    if (n_children > 0) {
+        state->actor_id_prev = children[n_children - 1];
     }
 
-    for (i = 0; i < state->n_rows; ++i) {
+    cacti_free(child_states);
+    state->children = children;
 
-        partial_t *results = safe_malloc(sizeof(partial_t));
-        results->row = i;
-        results->result = 0;
+    for (i = 0; i < state->n_rows; ++i) {
 
-        message_t message = {
-                .message_type = MSG_COMPUTE,
-                .data = (void*) results
-        };
+        partial_t results = { .row = i, .result = 0 };
 
-        if ((err = send_message(state->actor_id_prev, message)) != 0) {
+        if ((err = send_message_inline(state->actor_id_prev, MSG_COMPUTE, &results, sizeof(partial_t))) != 0) {
             syserr(err, "send_message COMPUTE failed");
         }
     }
 
 }
 
-
-/** Called when actor receives SETSTATE message
- *
- * @param stateptr      state of actor (actor_state_t**)
- * @param nbytes        irrelevant
- * @param data          a pointer to actor_state_t
- */
-void callback_setstate(void **stateptr, size_t nbytes, void *data) {
-    UNUSED_PARAMETER(nbytes);
-    int err;
-    *stateptr = data;
-    actor_state_t *state = *stateptr;
-    message_t message = { .message_type = MSG_READY };
-
-#ifdef DEBUG
-    fprintf(stdout, "SETSTATE: prev: %ld, curr: %ld \n", (**(actor_state_t **)stateptr).actor_id_prev, actor_id_self());
-#endif
-
-    if ((err = send_message(state->actor_id_first, message)) != 0) {
-        syserr(err, "send_message READY failed");
-    }
-
-}
-
-/** Called when actor receives COMPUTE message
+/** Adds the cell of the actor's column to a partial result and passes it on,
+ *  or records it if the row is complete
  *
- * @param stateptr      state of actor (actor_state_t**)
- * @param nbytes        irrelevant
- * @param data          pointer to partial_t
+ * @param state         state of actor
+ * @param results       partial result of a row
  */
-void callback_computation(void **stateptr, size_t nbytes, void *data) {
-    UNUSED_PARAMETER(nbytes);
-
+static void finish_cell(actor_state_t *state, partial_t *results) {
     int err;
-    partial_t *results = (partial_t*) data;
-    actor_state_t *state = *stateptr;
     int cell = results->row * state->n_actors_system + state->column_number;
 
-    // TODO: remove "* 500"
-    usleep(state->times[ cell ] * 1000 );
-
 #ifdef DEBUG
     fprintf(stdout, "\033[0;33mCOMPUTATION: %ld, %d, %d, nkol: %d, nrow: %d \033[0m \n",
             actor_id_self(), results->result, state->cells[ cell ], state->column_number, results->row);
@@ -219,12 +105,11 @@ void callback_computation(void **stateptr, size_t nbytes, void *data) {
     if (state->actor_id_first == actor_id_self()) {
         state->result[results->row] = results->result;
         state->n_rows_counted++;
-        free(results);
 
         if (state->n_rows_counted == state->n_rows) {
             message_t message = { .message_type = MSG_FREE };
 
-            if ((err = send_message(state->actor_id_prev, message)) != 0) {
+            if ((err = send_message(actor_id_self(), message)) != 0) {
                 syserr(err, "send_message FREE failed");
             }
 
@@ -234,15 +119,51 @@ void callback_computation(void **stateptr, size_t nbytes, void *data) {
     }
 
     // if first actor not reached yet, continue computation
-    message_t message = {
-            .message_type = MSG_COMPUTE,
-            .data = data
-    };
-
-    if ((err = send_message(state->actor_id_prev, message)) != 0) {
+    if ((err = send_message_inline(state->actor_id_prev, MSG_COMPUTE, results, sizeof(partial_t))) != 0) {
         syserr(err, "send_message failed");
     }
+}
+
+/** Called when actor receives COMPUTE message, the cell is ready after its time
+ *  has passed, meanwhile the actor takes other rows
+ *
+ * @param stateptr      state of actor (actor_state_t**)
+ * @param nbytes        irrelevant
+ * @param data          pointer to partial_t, kept in the mailbox
+ */
+void callback_computation(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+
+    partial_t *results = (partial_t*) data;
+    actor_state_t *state = *stateptr;
+    int cell = results->row * state->n_actors_system + state->column_number;
+
+    if (state->times[ cell ] <= 0) {
+        finish_cell(state, results);
+        return;
+    }
 
+    // the mailbox copy is gone when the callback returns
+    partial_t *delayed = cacti_alloc(sizeof(partial_t));
+    *delayed = *results;
+
+    message_t message = { .message_type = MSG_DONE, .data = delayed };
+    if (send_message_after(actor_id_self(), message, state->times[ cell ] * 1000000L) < 0) {
+        fatal("send_message_after DONE failed");
+    }
+}
+
+/** Called when the time of a cell has passed
+ *
+ * @param stateptr      state of actor (actor_state_t**)
+ * @param nbytes        irrelevant
+ * @param data          pointer to partial_t allocated by callback_computation
+ */
+void callback_done(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+
+    finish_cell(*stateptr, data);
+    cacti_free(data);
 }
 
 /**
@@ -262,18 +183,15 @@ void callback_free(void **stateptr, size_t nbytes, void *data) {
             state->actor_id_first, actor_id_self(), state->actor_id_prev);
 #endif
 
-    // Replicate message
-    if (state->actor_id_first != actor_id_self()) {
-        message_t message = { .message_type = MSG_FREE };
-
-        if ((err = send_message(state->actor_id_prev, message)) != 0) {
-            syserr(err, "send_message FREE failed");
+    if (state->actor_id_first == actor_id_self()) {
+        // tell all other columns at once
+        int n_children = state->n_actors_system - 1;
+        if (send_multicast(state->children, n_children, MSG_FREE, NULL, 0, NULL) != (size_t) n_children) {
+            fatal("send_multicast FREE failed");
         }
-    }
-
-    // Free resources
-    if (state->actor_id_first != actor_id_self()) {
-        free(*stateptr); // first actor's state isn't allocated dynamically
+        cacti_free(state->children); // first actor's state isn't allocated dynamically
+    } else {
+        cacti_free(*stateptr);
     }
 
     // Send goodbye to itself
@@ -301,25 +219,13 @@ int main() {
 
     actor_id_t first_actor;
 
-    const int action_size = 7;
+    const int action_size = 5;
     act_t actions[] = {
-            callback_hello,
+            NULL, // children get their state when they are spawned
             callback_init,
-            callback_hi_back,
-            callback_ready,
-            callback_setstate,
             callback_computation,
-            callback_free
-    };
-
-    act_t actions_first[] = {
-            NULL,
-            callback_init,
-            callback_hi_back,
-            callback_ready,
-            callback_setstate,
-            callback_computation,
-            callback_free
+            callback_free,
+            callback_done
     };
 
     role_t role = {
@@ -327,12 +233,7 @@ int main() {
             .prompts = actions
     };
 
-    role_t first_role = {
-            .nprompts = action_size,
-            .prompts = actions_first
-    };
-
-    actor_system_create(&first_actor, &first_role);
+    actor_system_create(&first_actor, &role);
 
     volatile int result[k];
 
@@ -346,8 +247,6 @@ int main() {
         .n_rows = k,
         .result = result,            // used only by first actor
         .role = &role,               // used only by first actor
-        .column_helper = n - 1,      // used only by first actor
-        .n_actors_ready = 1,         // used only by first actor
         .n_rows_counted = 0,         // used only by first actor
     };
 
@@ -1,244 +1,1166 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <string.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <errno.h>
+#include <stdint.h>
 
 #include "messages.h"
 #include "err.h"
 #include "queue.h"
-#include "blocking_queue.h"
+#include "scheduler.h"
+#include "actor_table.h"
+#include "slab.h"
+#include "timer.h"
+#include "coroutine.h"
+#include "future.h"
+#include "stats.h"
+#include "trace.h"
+#include "latency.h"
 
 //#define DEBUG 1
 
+#define PENDING_COUNT   0xffffffffL     ///< bits of actor_t.pending counting messages
+#define PENDING_CLOSED  (1L << 32)      ///< set in actor_t.pending once MSG_GODIE has been processed
+#define PENDING_OPEN    (1L << 33)      ///< set in actor_t.pending once the actor has been created
+#define PENDING_SHRINK  (1L << 34)      ///< set in actor_t.pending while the consumer shrinks the queue
+#define PENDING_WAITERS (1L << 35)      ///< set in actor_t.pending while a sender waits for room in the mailbox
+#define PENDING_GEN_SHIFT 40
+#define PENDING_GEN     (0x7fffffL << PENDING_GEN_SHIFT)    ///< generation of the slot, bumped when its actor is reclaimed
+
+#define ID_INDEX        0xffffffffL     ///< bits of actor_id_t holding the slot, the bits above hold its generation
+#define NO_FREE_SLOT    0xffffffffL     ///< index of the top of an empty free list
+
+#define WAITER_STRIPES  64              ///< number of locks guarding senders waiting for room in mailboxes
+
+#define MESSAGE_SHARED  (1L << 62)      ///< set in the type of a queued message whose data is a shared payload
+#define MESSAGE_INLINE  (1L << 61)      ///< set in the type of a queued message whose payload is in the mailbox
+#define MESSAGE_ASK     (1L << 60)      ///< set in the type of a queued message whose payload is an ask_t
+#define MESSAGE_FLAGS   (MESSAGE_SHARED | MESSAGE_INLINE | MESSAGE_ASK)
+
+/**
+ * An actor that asked to be told when a mailbox has room again.
+ */
+typedef struct space_waiter {
+    actor_id_t actor;               ///< receiver of the notification
+    message_type_t message_type;    ///< type of the notification
+    struct space_waiter *next;
+} space_waiter_t;
+
+/**
+ * A payload copied once for all receivers of a multicast, freed by the last of them.
+ */
+typedef struct shared_payload {
+    atomic_long refs;                               ///< receivers that have not finished with it yet
+    _Alignas(max_align_t) unsigned char data[];
+} shared_payload_t;
+
+/**
+ * Senders waiting for room in the mailboxes of actors with ids equal to the stripe's number
+ * modulo WAITER_STRIPES.
+ */
+typedef struct waiter_stripe {
+    pthread_mutex_t lock;           ///< guards PENDING_WAITERS and actor_t.waiters
+    pthread_cond_t space;           ///< threads outside of the pool wait here
+} waiter_stripe_t;
+
+/**
+ * The inline payload of an ask: the message data and the future the reply goes to.
+ */
+typedef struct ask {
+    void *data;
+    size_t nbytes;
+    long future;
+} ask_t;
+
+/**
+ * A message a suspended coroutine has not awaited, processed once its callback returns.
+ */
+typedef struct stashed {
+    struct stashed *next;
+    message_t message;
+    int shared;                         ///< 1 if message.data is a multicast payload
+    long request;                       ///< future of an ask, -1 for other messages
+    long sent_at;                       ///< time the message was pushed into the mailbox
+    char payload[MESSAGE_INLINE_MAX];   ///< copy of an inline payload, message.data points here then
+} stashed_t;
+
 /**
  * A representation of a single actor
  */
 typedef struct actor {
     role_t *role;                ///< array of callbacks
     queue_t* volatile messages;  ///< queue of messages
-    pthread_mutex_t lock;        ///< a mutex associated with this actor
-    volatile int processed_now;  ///< 0 if an actor callback has been invoked on a thread
+    queue_t* _Atomic urgent;     ///< queue of control and urgent messages, taken first; allocated by the first of them
+    atomic_long pending;         ///< messages sent and not yet processed, together with PENDING_OPEN
+                                 ///< and PENDING_CLOSED; the sender that makes it non zero schedules the actor
     void *stateptr;              ///< a state of an actor
-    volatile int goodbye;        ///< 1 if actor has processed or its queue of messages contains MSQ_GODIE, 0 o/w
+    space_waiter_t *waiters;     ///< actors to notify once the mailbox has room, guarded by the stripe's lock
+    atomic_long next_free;       ///< next slot of the free list while the slot is unused
+    int dispatcher;              ///< dispatcher the actor runs on
+    int mailbox_node;            ///< NUMA node the mailbox was allocated on, -1 if not known;
+                                 ///< written by the worker running the actor once the mailbox has moved
+    atomic_int home;             ///< worker of the dispatcher the actor runs on, -1 if any
+    atomic_long migrations;      ///< times the actor has run on another worker than the time before
+    atomic_long processed;       ///< messages taken by workers, written only by the worker running the actor
+    atomic_long high_water;      ///< most messages pending when a worker took the actor, written as processed
+    atomic_long runnable_since;  ///< time the actor was last put on a run queue, set only if CACTI_LATENCY is set
+
+    // used only by the worker running the actor
+    coroutine_t *coroutine;      ///< callback suspended in actor_await, NULL if none
+    message_type_t awaited;      ///< type of the message the callback waits for
+    message_t *received;         ///< where the awaited message goes
+    int await_result;            ///< what actor_await returns
+    long request;                ///< future of the ask the suspended callback was started with
+    stashed_t *stash_head;       ///< messages taken while the callback waits, oldest first
+    stashed_t *stash_tail;
+    long n_stashed;              ///< length of the stash, counted in pending unless a callback is suspended
 } actor_t;
 
 /**
  * A representation of system of actors
  */
-typedef struct actors {
-    pthread_mutex_t lock;                    ///< a mutex associated with the system
-    volatile int num;                        ///< number of actors in the system
-    actor_t** volatile actors;               ///< dynamic array of pointers to actors
-    volatile int capacity;                   ///< space allocated for actors array
-    blocking_queue_t* volatile waiting;      ///< a blocking queue of actors that have pending messages
-    volatile int n_processed_now;            ///< number of actors processed by the thread pool at the moment
-    volatile int n_finished;                 ///< number actors that processed MSG_GODIE and all messages after it
-    volatile int interrupted;                ///< 1 if system was interrupted, 0 o/w
+struct actors {
+    actor_table_t *actors;                   ///< actors indexed by their ids
+    scheduler_t **waiting;                   ///< run queues of actors that have pending messages, one per dispatcher
+    char **dispatchers;                      ///< names of the dispatchers, NULL for the default one, which is first
+    int n_dispatchers;
+    atomic_long n_alive;                     ///< number of actors that have not processed MSG_GODIE and all messages after it
+    _Atomic uint64_t free_slots;             ///< slots of reclaimed actors, the index of the top is in the lower half
+                                             ///< and a counter against ABA in the upper one
+    atomic_int interrupted;                  ///< 1 if system was interrupted, 0 o/w
+    long mailbox_limit;                      ///< messages an actor may have pending
+    size_t quota;                            ///< messages an actor may process in one activation
+    long quota_ns;                           ///< time an activation may take, 0 if unlimited
+    waiter_stripe_t stripes[WAITER_STRIPES]; ///< senders waiting for room in mailboxes
+    timer_service_t* _Atomic timers;         ///< delayed messages, created by the first of them
+    future_pool_t *futures;                  ///< correlation slots of asks
+    stats_slot_t *stats;                     ///< counters of each worker, of all dispatchers in order, and
+                                             ///< the last one of threads outside of the pools
+    int n_stats;
+    latency_table_t **latency;               ///< latency histograms of each worker, NULL unless CACTI_LATENCY is set
+
+};
+
+static idle_stats_t last_idle_stats; ///< idle stats of the last system, kept after it is destroyed
+static cacti_stats_t last_stats;     ///< counters of the last system, kept after it is destroyed
+static latency_table_t *last_latency = NULL; ///< histograms of the last system, kept after it is destroyed
+
+static __thread actors_t *attached = NULL; ///< system the calling worker belongs to, NULL outside of pools
+static __thread int attached_dispatcher = -1; ///< dispatcher the calling worker belongs to
+static __thread int attached_worker = -1;  ///< number of the calling worker in its dispatcher
+static __thread long current_request = -1; ///< future of the ask the calling worker's callback is processing
+static __thread stats_slot_t *own_stats = NULL; ///< counters of the calling worker
+static __thread latency_table_t *own_latency = NULL; ///< latency histograms of the calling worker
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/// adds to a counter of the calling thread, in the slot shared by threads outside of the pools if it has none
+static inline void count(actors_t *ac, int counter, long n) {
+    if (attached == ac)
+        stats_add(own_stats, counter, n, 1);
+    else
+        stats_add(&ac->stats[ac->n_stats - 1], counter, n, 0);
+}
+
+/// slot of the actor with the given id
+static inline long id_index(actor_id_t actor) {
+    return actor & ID_INDEX;
+}
+
+/// generation bits of actor_t.pending that match the given id
+static inline long id_generation(actor_id_t actor) {
+    return (actor >> 32) << PENDING_GEN_SHIFT;
+}
+
+/**
+ * Takes a slot off the free list.
+ * @return          index of the slot, -1 if the list is empty
+ */
+static long pop_free_slot(actors_t *ac) {
+    actor_t *slot;
+    uint64_t next, head = atomic_load(&ac->free_slots);
+
+    do {
+        if ((head & ID_INDEX) == NO_FREE_SLOT)
+            return -1;
+
+        slot = actor_table_get(ac->actors, head & ID_INDEX);
+        next = ((head >> 32) + 1) << 32 | (uint64_t) atomic_load(&slot->next_free);
+    } while (!atomic_compare_exchange_weak(&ac->free_slots, &head, next));
+
+    return head & ID_INDEX;
+}
+
+/// puts a slot on the free list
+static void release_slot(actors_t *ac, long index) {
+    actor_t *slot = actor_table_get(ac->actors, index);
+    uint64_t next, head = atomic_load(&ac->free_slots);
+
+    do {
+        atomic_store(&slot->next_free, (long) (head & ID_INDEX));
+        next = ((head >> 32) + 1) << 32 | (uint64_t) index;
+    } while (!atomic_compare_exchange_weak(&ac->free_slots, &head, next));
+}
 
-} actors_t;
+/// NUMA node of the calling thread as a worker of a dispatcher, -1 outside of its pool on a machine of many nodes
+static int own_node(actors_t *ac, int dispatcher) {
+    scheduler_t *s = ac->waiting[dispatcher];
 
-static actors_t AC; ///< The system of actors
+    if (attached == ac && attached_dispatcher == dispatcher)
+        return scheduler_node(s, attached_worker);
+    return s->n_nodes > 1 ? -1 : 0;
+}
 
 /**
- * Allocates memory for a new actor and initializes it
+ * Creates an actor in a slot taken for it and makes it visible to senders.
  * @param role      an array of callbacks
- * @return          pointer to a new actor
+ * @param home      worker of the dispatcher the actor should run on, -1 for any
+ * @param state     initial state of the actor
+ * @return          id of the actor
  */
-static actor_t* generate_actor(role_t *const role) {
-    int err;
-
-    actor_t* created_actor = safe_malloc(sizeof(actor_t));
+static actor_id_t generate_actor(actors_t *ac, long index, role_t *const role, int dispatcher, int home,
+                                 void *state) {
+    actor_t* created_actor = actor_table_get(ac->actors, index);
+    long generation = atomic_load(&created_actor->pending) & PENDING_GEN; // 0 in a new slot
 
     created_actor->role          = role;
     created_actor->messages      = queue_init();
-    created_actor->processed_now = 0;
-    created_actor->goodbye       = 0;
-    created_actor->stateptr      = NULL;
+    atomic_store(&created_actor->urgent, NULL);
+    created_actor->stateptr      = state;
+    created_actor->waiters       = NULL;
+    created_actor->dispatcher    = dispatcher;
+    created_actor->mailbox_node  = own_node(ac, dispatcher);
+    created_actor->coroutine     = NULL;
+    created_actor->stash_head    = NULL;
+    created_actor->stash_tail    = NULL;
+    created_actor->n_stashed     = 0;
+    atomic_store(&created_actor->home, home);
+    atomic_store(&created_actor->migrations, 0);
+    atomic_store(&created_actor->processed, 0);
+    atomic_store(&created_actor->high_water, 0);
+
+    atomic_fetch_add(&ac->n_alive, 1);
+    atomic_store(&created_actor->pending, generation | PENDING_OPEN);
+
+    actor_id_t id = (generation >> PENDING_GEN_SHIFT) << 32 | index;
+    trace(TRACE_SPAWN, TRACE_INSTANT, id, 0);
+    return id;
+}
+
+/**
+ * Frees the mailbox of an actor that has processed all messages after MSG_GODIE
+ * and puts its slot on the free list. The slot gets the next generation, so ids
+ * of the dead actor never match whatever lives in the slot later.
+ * @param pending   the final value of actor_t.pending, nobody else may change it anymore
+ */
+static void reclaim_actor(actors_t *ac, actor_id_t actor, actor_t *actor_temp, long pending) {
+    queue_t *urgent = atomic_load(&actor_temp->urgent);
+
+    queue_destroy(actor_temp->messages);
+    actor_temp->messages = NULL;
+
+    if (urgent != NULL) {
+        queue_destroy(urgent);
+        atomic_store(&actor_temp->urgent, NULL);
+    }
+
+    atomic_store(&actor_temp->pending,
+                 (long) (((unsigned long) pending + (1UL << PENDING_GEN_SHIFT)) & PENDING_GEN));
+    release_slot(ac, id_index(actor));
+}
 
-    if ((err = pthread_mutex_init(&created_actor->lock, 0)) != 0)
-        syserr(err, "mutex init failed");
+/**
+ * Looks a dispatcher up by its name.
+ * @return          index of the dispatcher, 0 for NULL, -1 if there is no such dispatcher
+ */
+static int find_dispatcher(actors_t *ac, const char *name) {
+    int i;
+
+    if (name == NULL)
+        return 0;
 
-    return created_actor;
+    for (i = 1; i < ac->n_dispatchers; ++i)
+        if (strcmp(ac->dispatchers[i], name) == 0)
+            return i;
+
+    return -1;
 }
 
 /**
  * Initiates the system of actors.
  * @param actor     output parameter, assigns an id of first actor in the system
  * @param role      array of callbacks for the first actor in the system
- * @return          0 if operation is successful, -1 o/w
+ * @param config    parameters of the system, with valid dispatchers
+ * @param node      NUMA node of each worker, of the default dispatcher first and then of the others in order
+ * @return          the system, NULL if it could not be created
  */
-int init_actors_system(actor_id_t *actor, role_t *const role) {
-    int err;
-    actor_id_t id_first = 0;
-
-    AC.num              = 1;
-    AC.n_processed_now  = 0;
-    AC.n_finished       = 0;
-    AC.interrupted      = 0;
-    AC.capacity         = 4;
-    AC.waiting          = blocking_queue_init();
-    AC.actors           = safe_malloc(AC.capacity * sizeof(actor_t*));
-    AC.actors[0]        = generate_actor(role);
-    *actor              = id_first;
+actors_t* init_actors_system(actor_id_t *actor, role_t *const role, const actor_system_config_t *config,
+                             const int *node) {
+    int i, err, dispatcher;
+    pthread_condattr_t attr;
+    actors_t *ac = safe_malloc(sizeof(actors_t));
+
+    ac->quota            = config->quota != 0 ? config->quota : ACTOR_QUOTA;
+    ac->quota_ns         = config->quota_ns;
+    ac->mailbox_limit    = config->mailbox_limit != 0 ? (long) config->mailbox_limit : ACTOR_QUEUE_LIMIT;
+    ac->n_dispatchers    = (int) config->n_dispatchers + 1;
+    ac->waiting          = safe_malloc(ac->n_dispatchers * sizeof(scheduler_t*));
+    ac->dispatchers      = safe_malloc(ac->n_dispatchers * sizeof(char*));
+    ac->actors           = actor_table_init(sizeof(actor_t), CAST_LIMIT);
+    ac->futures          = future_pool_init();
+
+    ac->waiting[0]     = scheduler_init(config->n_workers, node);
+    ac->dispatchers[0] = NULL;
+    ac->n_stats        = config->n_workers + 1;
+    node += config->n_workers;
+
+    for (i = 1; i < ac->n_dispatchers; ++i) {
+        const dispatcher_config_t *d = &config->dispatchers[i - 1];
+
+        ac->waiting[i]     = scheduler_init(d->n_workers, node);
+        ac->dispatchers[i] = safe_malloc((int) strlen(d->name) + 1);
+        strcpy(ac->dispatchers[i], d->name);
+        ac->n_stats       += d->n_workers;
+        node += d->n_workers;
+    }
+
+    ac->stats = safe_aligned_malloc(ac->n_stats * sizeof(stats_slot_t));
+    memset(ac->stats, 0, ac->n_stats * sizeof(stats_slot_t));
+
+    ac->latency = NULL;
+#if CACTI_LATENCY
+    ac->latency = safe_malloc((ac->n_stats - 1) * sizeof(latency_table_t*));
+    for (i = 0; i < ac->n_stats - 1; ++i)
+        ac->latency[i] = latency_table_init();
+#endif
+
+    atomic_init(&ac->n_alive, 0);
+    atomic_init(&ac->free_slots, NO_FREE_SLOT);
+    atomic_init(&ac->interrupted, 0);
+    atomic_init(&ac->timers, NULL);
+
+    // timed waits measure time with the monotonic clock
+    if ((err = pthread_condattr_init(&attr)) != 0)
+        syserr(err, "condattr init failed");
+    if ((err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)) != 0)
+        syserr(err, "condattr setclock failed");
+
+    for (i = 0; i < WAITER_STRIPES; ++i) {
+        if ((err = pthread_mutex_init(&ac->stripes[i].lock, 0)) != 0)
+            syserr(err, "mutex init failed");
+        if ((err = pthread_cond_init(&ac->stripes[i].space, &attr)) != 0)
+            syserr(err, "cond init failed");
+    }
 
-    if ((err = pthread_mutex_init(&AC.lock, 0)) != 0)
-        syserr(err, "mutex init failed");
+    if ((err = pthread_condattr_destroy(&attr)) != 0)
+        syserr(err, "condattr destroy failed");
+
+    if ((dispatcher = find_dispatcher(ac, role->dispatcher)) < 0) {
+        messages_destroy(ac);
+        return NULL;
+    }
+
+    actor_id_t id_first = generate_actor(ac, actor_table_reserve(ac->actors, 1), role, dispatcher, -1, NULL);
+    *actor              = id_first;
 
     // implicitly send hello message
 
     message_t hello_message = { .message_type = MSG_HELLO };
-    return send_message(id_first, hello_message);
+    if (push_message(ac, id_first, hello_message, NULL, 0) != 0) {
+        messages_destroy(ac);
+        return NULL;
+    }
+
+    return ac;
+}
+
+/**
+ * Worker of its dispatcher a new actor starts on: the spawning actor's one, if it works
+ * for the same dispatcher, or one on the node its role asks for.
+ */
+static int spawn_home(actors_t *ac, role_t *const role, int dispatcher) {
+    scheduler_t *s = ac->waiting[dispatcher];
+    int home = attached == ac && attached_dispatcher == dispatcher ? attached_worker : -1;
+
+    if (role->node != 0 && (home < 0 || (role->node - 1) % s->n_nodes != scheduler_node(s, home)))
+        home = scheduler_place(s, role->node - 1);
+
+    return home;
 }
 
-/** TODO: change desc
- * Creates a new actor and adds it to the running system.
- * Sends MSG_HELLO to this new actor.
- * @param role     - array of callbacks for the new actor,
- * @return           0 on success, -1 on failure.
+/**
+ * Creates n actors of a role and sends MSG_HELLO to each of them, with the id of the calling
+ * actor as data, -1 outside of actors. Takes slots off the free list, and reserves those
+ * still missing at once.
+ * @param dispatcher    name of the dispatcher the actors run on, NULL for the one of the role
+ * @param states        initial states of the actors, NULL to start all of them with NULL
+ * @param[out] ids      ids of the actors
+ * @return              0 on success, -1 if they would exceed CAST_LIMIT, the dispatcher does not exist
+ *                      or the system has ended, nothing is created then
+ */
+int spawn_actors(actors_t *ac, role_t *const role, const char *dispatcher, size_t n, void *const *states,
+                 actor_id_t *ids) {
+    size_t i, taken;
+    long index, first = 0;
+    actor_id_t parent = attached == ac ? actor_id_self() : -1;
+    int d = find_dispatcher(ac, dispatcher != NULL ? dispatcher : role->dispatcher);
+
+    if (d < 0 || atomic_load(&ac->interrupted) || atomic_load(&ac->waiting[0]->interrupted))
+        return -1;
+
+    for (taken = 0; taken < n && (index = pop_free_slot(ac)) >= 0; ++taken)
+        ids[taken] = index;
+
+    if (taken < n && (first = actor_table_reserve(ac->actors, (long) (n - taken))) < 0) {
+        for (i = 0; i < taken; ++i)
+            release_slot(ac, ids[i]);
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        index  = i < taken ? ids[i] : first + (long) (i - taken);
+        ids[i] = generate_actor(ac, index, role, d, spawn_home(ac, role, d), states != NULL ? states[i] : NULL);
+    }
+
+    for (i = 0; i < n; ++i) {
+        if (push_message(ac, ids[i], (message_t){
+                .message_type = MSG_HELLO,
+                .nbytes = sizeof(actor_id_t),
+                .data = (void*) parent
+        }, NULL, 0) != 0 && !atomic_load(&ac->interrupted)) {
+            fatal("send message HELLO failed");
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Creates a new actor and adds it to the running system, on the worker of the spawning
+ * actor or on a worker of the node its role asks for.
+ * Sends MSG_HELLO to this new actor. Does nothing if CAST_LIMIT actors are alive already.
+ * @param data     - array of callbacks for the new actor
  */
 void execute_spawn(void **stateptr, size_t nbytes, void *data) {
     (void)(stateptr); // suppress unused argument warning
     (void)(nbytes);  // suppress unused argument warning
 
-    role_t *role = data;
-    safe_lock(&AC.lock);
+    actor_id_t ignored;
+    spawn_actors(attached, data, NULL, 1, NULL, &ignored);
+}
+
+/**
+ * Returns the slot of the actor with the given id. The slot may hold another
+ * generation, its pending word tells.
+ * @return              NULL if the id is incorrect
+ */
+static actor_t* find_actor(actors_t *ac, actor_id_t actor) {
+    if (actor < 0 || id_index(actor) >= actor_table_size(ac->actors)) { // check if actor's id is correct
+        return NULL;
+    }
+
+    // NULL if the id is reserved by a spawn that is still in progress
+    return actor_table_get(ac->actors, id_index(actor));
+}
+
+/// the urgent lane of an actor, created by the first sender that needs it
+static queue_t* urgent_lane(actor_t *actor_temp) {
+    queue_t *expected = NULL, *created;
+    queue_t *urgent = atomic_load(&actor_temp->urgent);
+
+    if (urgent != NULL)
+        return urgent;
+
+    created = queue_init();
+    if (atomic_compare_exchange_strong(&actor_temp->urgent, &expected, created))
+        return created;
+
+    queue_destroy(created);
+    return expected;
+}
+
+/// drops the reference of a receiver, or of several, to a shared payload
+static void release_shared(void *data, long n) {
+    shared_payload_t *shared = (shared_payload_t*) ((char*) data - offsetof(shared_payload_t, data));
+
+    if (atomic_fetch_sub(&shared->refs, n) == n)
+        slab_free(shared);
+}
+
+/// MSG_GODIE and MSG_SPAWN always go to the urgent lane
+static inline int lane_flags(message_type_t message_type, int flags) {
+    return message_type == MSG_GODIE || message_type == MSG_SPAWN ? flags | PUSH_URGENT : flags;
+}
+
+/**
+ * Puts a message into the mailbox of an actor, leaving scheduling to the caller.
+ * @param flags         as push_message, after lane_flags
+ * @param[out] s        run queues of the actor's dispatcher, set if the actor has to be scheduled
+ * @param[out] home     the worker the actor should run on, set if the actor has to be scheduled
+ * @return              1 if the actor was idle and has to be scheduled, o/w as push_message
+ */
+static int enqueue_message(actors_t *ac, actor_id_t actor, message_t message, const void *payload, int flags,
+                           scheduler_t **s, int *home) {
+    long pending, limit;
+    queue_t *lane;
+
+    if (flags & PUSH_UNBOUNDED)
+        limit = PENDING_COUNT;
+    else if (flags & PUSH_URGENT)
+        limit = ac->mailbox_limit + ACTOR_URGENT_LIMIT;
+    else
+        limit = ac->mailbox_limit;
+
+    if (atomic_load(&ac->interrupted)) { // check if system has been interrupted
+        return -1;
+    }
 
-    if (AC.capacity == AC.num) {
-        AC.capacity      *= 2;
-        AC.actors         = realloc(AC.actors, AC.capacity * sizeof(actor_t*));
+    actor_t* actor_temp = find_actor(ac, actor);
+    if (actor_temp == NULL) {
+        return -2;
     }
 
-    if (AC.actors == NULL) {
-        fatal("Realloc failed");
+    // reserve a place in the queue, fails once MSG_GODIE has been processed
+    pending = atomic_load(&actor_temp->pending);
+    for (;;) {
+        if ((pending & PENDING_GEN) != id_generation(actor))
+            return -1; // the actor is gone and its slot has been reused
+        if (!(pending & PENDING_OPEN))
+            return -2;
+        if (pending & PENDING_CLOSED)
+            return -1;
+        if ((pending & PENDING_COUNT) >= limit) {
+            count(ac, STATS_REJECTED, 1);
+            return -3;
+        }
+        if (pending & PENDING_SHRINK) { // lasts as long as a few calls to free
+            sched_yield();
+            pending = atomic_load(&actor_temp->pending);
+            continue;
+        }
+        if (atomic_compare_exchange_weak(&actor_temp->pending, &pending, pending + 1))
+            break;
     }
 
-    AC.actors[AC.num]     = generate_actor(role);
-    actor_id_t actor      = AC.num++;
+    lane = (flags & PUSH_URGENT) ? urgent_lane(actor_temp) : actor_temp->messages;
 
-    safe_unlock(&AC.lock);
+    if (payload != NULL)
+        message.message_type |= MESSAGE_INLINE;
 
-    if (send_message(actor, (message_t){
-            .message_type = MSG_HELLO,
-            .nbytes = sizeof(actor_id_t),
-            .data = (void*) actor_id_self()
-    }) != 0) {
-        fatal("send message HELLO failed");
+    if ((payload == NULL ? queue_push(lane, message) : queue_push_inline(lane, message, payload)) != 0) {
+        fatal("queue push failed");
+    }
+
+    count(ac, STATS_SENT, 1);
+    trace(TRACE_SEND, TRACE_INSTANT, actor, message.message_type & ~MESSAGE_FLAGS);
+
+    // the actor was idle, nobody else will schedule it
+    if ((pending & PENDING_COUNT) == 0) {
+#if CACTI_LATENCY
+        atomic_store_explicit(&actor_temp->runnable_since, now_ns(), memory_order_relaxed);
+#endif
+        *s    = ac->waiting[actor_temp->dispatcher];
+        *home = atomic_load_explicit(&actor_temp->home, memory_order_relaxed);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Puts a message into the mailbox of an actor and schedules the actor if it was idle.
+ * MSG_GODIE and MSG_SPAWN always go to the urgent lane. Urgent messages may exceed
+ * the mailbox limit by ACTOR_URGENT_LIMIT.
+ * @param payload       message.nbytes bytes to be copied into the mailbox, NULL to send message.data as it is
+ * @param flags         PUSH_UNBOUNDED and PUSH_URGENT
+ * @return              -2 if actor is incorrect, -1 if actor does not accept messages
+ *                      (also if it is dead and reclaimed), -3 if its mailbox is full, 0 o/w
+ */
+int push_message(actors_t *ac, actor_id_t actor, message_t message, const void *payload, int flags) {
+    int res, home;
+    scheduler_t *s;
+
+    flags = lane_flags(message.message_type, flags);
+    if ((res = enqueue_message(ac, actor, message, payload, flags, &s, &home)) != 1)
+        return res;
+
+    if (flags & PUSH_URGENT)
+        scheduler_push_urgent(s, actor);
+    else
+        scheduler_push(s, actor, home);
+
+    return 0;
+}
+
+/**
+ * Sends one message to n actors. A payload of nbytes > 0 bytes is copied once into a block
+ * shared by the receivers, the last one to finish with it frees it. The actors that become
+ * runnable are scheduled in one batch per dispatcher, after all mailboxes have got the message.
+ * @param payload       message data as it is if nbytes is 0
+ * @param[out] results  result of push_message for each actor, may be NULL
+ * @return              number of actors that accepted the message
+ */
+size_t multicast(actors_t *ac, const actor_id_t *actors, size_t n, message_type_t message_type,
+                 const void *payload, size_t nbytes, int *results) {
+    size_t i, j, done, accepted = 0, n_runnable = 0;
+    int d, res, flags = lane_flags(message_type, 0);
+    shared_payload_t *shared = NULL;
+    message_t message = { .message_type = message_type, .nbytes = nbytes, .data = (void*) payload };
+
+    if (nbytes > 0 && (flags & PUSH_URGENT)) { // MSG_GODIE and MSG_SPAWN carry no payload
+        for (i = 0; results != NULL && i < n; ++i)
+            results[i] = -2;
+        return 0;
+    }
+
+    if (nbytes > 0) {
+        shared = slab_alloc(sizeof(shared_payload_t) + nbytes);
+        atomic_init(&shared->refs, (long) n + 1); // the sender holds one until all pushes are done
+        memcpy(shared->data, payload, nbytes);
+        message.message_type |= MESSAGE_SHARED;
+        message.data          = shared->data;
+    }
+
+    actor_id_t *runnable = slab_alloc(n * sizeof(actor_id_t));
+    int *homes           = slab_alloc(n * sizeof(int));
+    scheduler_t **queues = slab_alloc(n * sizeof(scheduler_t*));
+
+    for (i = 0; i < n; ++i) {
+        if ((res = enqueue_message(ac, actors[i], message, NULL, flags, &queues[n_runnable], &homes[n_runnable])) == 1) {
+            runnable[n_runnable++] = actors[i];
+            res = 0;
+        }
+
+        accepted += res == 0;
+        if (results != NULL)
+            results[i] = res;
+    }
+
+    // gather the actors of each dispatcher in front of those not scheduled yet
+    for (d = 0, done = 0; d < ac->n_dispatchers && done < n_runnable; ++d) {
+        for (i = j = done; i < n_runnable; ++i) {
+            if (queues[i] != ac->waiting[d])
+                continue;
+
+            actor_id_t actor = runnable[i];
+            int home         = homes[i];
+            runnable[i] = runnable[j], homes[i] = homes[j], queues[i] = queues[j];
+            runnable[j] = actor, homes[j++] = home;
+        }
+
+        scheduler_push_many(ac->waiting[d], runnable + done, homes + done, j - done, flags & PUSH_URGENT);
+        done = j;
     }
+
+    if (shared != NULL)
+        release_shared(shared->data, (long) (n - accepted) + 1);
+
+    slab_free(runnable);
+    slab_free(homes);
+    slab_free(queues);
+    return accepted;
+}
+
+/**
+ * Announces that the caller is about to wait for room in the mailbox of an actor.
+ * Must be called with the stripe's lock held.
+ * @return              1 if the mailbox is still full, 0 if a send may succeed (or fail for good) now
+ */
+static int register_waiter(actors_t *ac, actor_id_t actor, actor_t *actor_temp) {
+    long pending = atomic_load(&actor_temp->pending);
+
+    // a consumer that takes messages after this sees the flag and wakes the stripe up
+    do {
+        if ((pending & PENDING_GEN) != id_generation(actor) || (pending & PENDING_CLOSED)
+                || (pending & PENDING_COUNT) < ac->mailbox_limit || atomic_load(&ac->interrupted))
+            return 0;
+    } while (!atomic_compare_exchange_weak(&actor_temp->pending, &pending, pending | PENDING_WAITERS));
+
+    return 1;
 }
 
 /**
- * Sends message to an actor.
+ * Sends message to an actor, waiting for room in its mailbox if it is full.
+ * Only threads outside of pools wait, a worker could wait for itself.
  * @param actor         receiver
  * @param message       message
- * @return              -2 if actor is incorrect, -1 if actor does not accept messages, 0 o/w
+ * @param timeout_ns    longest time to wait in nanoseconds, negative to wait as long as needed
+ * @return              as push_message, -3 if the mailbox is still full after timeout_ns
  */
-int send_message(actor_id_t actor, message_t message) {
-    int add_to_queue;
-    safe_lock(&AC.lock); // system lock
+int push_message_timed(actors_t *ac, actor_id_t actor, message_t message, long timeout_ns) {
+    int res, err = 0;
+    struct timespec deadline;
 
-#ifdef DEBUG
-    fprintf(stdout, "\033[0;31msend_message to %ld (%ld) \033[0m \n", actor, message.message_type);
-#endif
+    if ((res = push_message(ac, actor, message, NULL, 0)) != -3 || attached != NULL || timeout_ns == 0)
+        return res;
 
-    if (AC.interrupted) { // check if system has been interrupted
-        safe_unlock(&AC.lock); // system unlock
-        return -1;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    long nsec = deadline.tv_nsec + timeout_ns % 1000000000L;
+    deadline.tv_sec  += timeout_ns / 1000000000L + nsec / 1000000000L;
+    deadline.tv_nsec  = nsec % 1000000000L;
+
+    actor_t *actor_temp = find_actor(ac, actor);
+    waiter_stripe_t *stripe = &ac->stripes[id_index(actor) % WAITER_STRIPES];
+
+    while ((res = push_message(ac, actor, message, NULL, 0)) == -3 && err != ETIMEDOUT) {
+        safe_lock(&stripe->lock);
+
+        if (register_waiter(ac, actor, actor_temp)) {
+            err = timeout_ns < 0 ? pthread_cond_wait(&stripe->space, &stripe->lock)
+                                 : pthread_cond_timedwait(&stripe->space, &stripe->lock, &deadline);
+            if (err != 0 && err != ETIMEDOUT)
+                syserr(err, "cond wait failed");
+        }
+
+        safe_unlock(&stripe->lock);
     }
 
-    if (actor >= AC.num || actor < 0) { // check if actor's id is correct
-        safe_unlock(&AC.lock); // system unlock
+    return res;
+}
+
+/**
+ * Asks for a message to the calling actor once the mailbox of another actor has room.
+ * The notification has the given type and carries the id of the other actor as its data,
+ * it is sent right away if the mailbox is not full anymore. It is not limited by the
+ * size of the caller's mailbox. May be called only by actors.
+ * @param actor         actor whose mailbox is full
+ * @param message_type  type of the notification
+ * @return              -2 if actor is incorrect, -1 if called outside of an actor, 0 o/w
+ */
+int notify_on_space(actor_id_t actor, message_type_t message_type) {
+    space_waiter_t *w;
+    actors_t *ac = attached;
+
+    if (ac == NULL)
+        return -1;
+
+    actor_t *actor_temp = find_actor(ac, actor);
+    if (actor_temp == NULL)
         return -2;
+
+    actor_id_t self = actor_id_self();
+    waiter_stripe_t *stripe = &ac->stripes[id_index(actor) % WAITER_STRIPES];
+    safe_lock(&stripe->lock);
+
+    if (register_waiter(ac, actor, actor_temp)) {
+        for (w = actor_temp->waiters; w != NULL; w = w->next)
+            if (w->actor == self && w->message_type == message_type)
+                break;
+
+        if (w == NULL) {
+            w = slab_alloc(sizeof(space_waiter_t));
+            w->actor             = self;
+            w->message_type      = message_type;
+            w->next              = actor_temp->waiters;
+            actor_temp->waiters  = w;
+        }
+
+        safe_unlock(&stripe->lock);
+        return 0;
     }
 
-    actor_t* actor_temp = AC.actors[actor];
-    safe_unlock(&AC.lock); // system unlock
+    safe_unlock(&stripe->lock);
+
+    push_message(ac, self, (message_t) {
+            .message_type = message_type,
+            .nbytes = sizeof(actor_id_t),
+            .data = (void*) actor
+    }, NULL, PUSH_UNBOUNDED);
+    return 0;
+}
+
+/**
+ * Tells how many times an actor has run on another worker than the time before.
+ * @return              the number of migrations, -2 if actor is incorrect, -1 if it is gone
+ */
+long actor_migrations_of(actors_t *ac, actor_id_t actor) {
+    actor_t *actor_temp = find_actor(ac, actor);
+    if (actor_temp == NULL)
+        return -2;
+
+    long pending = atomic_load(&actor_temp->pending);
+    if ((pending & PENDING_GEN) != id_generation(actor))
+        return -1;
+    if (!(pending & PENDING_OPEN))
+        return -2;
+
+    long migrations = atomic_load_explicit(&actor_temp->migrations, memory_order_relaxed);
+
+    // the slot may have been reused in the meantime
+    if ((atomic_load(&actor_temp->pending) & PENDING_GEN) != id_generation(actor))
+        return -1;
+
+    return migrations;
+}
+
+/**
+ * Reads the counters of an actor.
+ * @return              0 on success, -2 if actor is incorrect, -1 if it is gone
+ */
+int actor_stats_of(actors_t *ac, actor_id_t actor, actor_stats_t *stats) {
+    actor_t *actor_temp = find_actor(ac, actor);
+    if (actor_temp == NULL)
+        return -2;
 
+    long pending = atomic_load(&actor_temp->pending);
+    if ((pending & PENDING_GEN) != id_generation(actor))
+        return -1;
+    if (!(pending & PENDING_OPEN))
+        return -2;
 
-    safe_lock(&actor_temp->lock); // actor lock
+    stats->processed  = atomic_load_explicit(&actor_temp->processed, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&actor_temp->high_water, memory_order_relaxed);
+    stats->pending    = pending & PENDING_COUNT;
 
-    if (actor_temp->goodbye == 1) { // check if actor has processed MSG_GODIE
-        safe_unlock(&actor_temp->lock); // actor unlock
+    // the slot may have been reused in the meantime
+    if ((atomic_load(&actor_temp->pending) & PENDING_GEN) != id_generation(actor))
         return -1;
+
+    return 0;
+}
+
+/// delivers the message of an expired timer, it does not count against the mailbox limit
+static int fire_timer(void *data, actor_id_t actor, message_t message) {
+    return push_message(data, actor, message, NULL, PUSH_UNBOUNDED) != 0;
+}
+
+/**
+ * Sends a message after a delay, and then periodically if period_ns > 0,
+ * from the timer service of the system, which is started on first use.
+ * @return              id of the timer, -1 if too many timers are pending
+ */
+long schedule_message(actors_t *ac, actor_id_t actor, message_t message, long delay_ns, long period_ns) {
+    timer_service_t *timers = atomic_load(&ac->timers);
+
+    if (timers == NULL) {
+        timer_service_t *created = timer_service_init(fire_timer, ac);
+        if (atomic_compare_exchange_strong(&ac->timers, &timers, created))
+            timers = created;
+        else
+            timer_service_destroy(created); // another thread was first
     }
 
-    add_to_queue = !actor_temp->processed_now
-            && queue_empty(actor_temp->messages);
-    queue_push(actor_temp->messages, message);
+    return timer_add(timers, actor, message, delay_ns, period_ns);
+}
+
+/**
+ * Cancels a message scheduled by schedule_message.
+ * @return              0 on success, -1 if it has been sent (for the last time) or cancelled already
+ */
+int cancel_scheduled(actors_t *ac, long timer) {
+    timer_service_t *timers = atomic_load(&ac->timers);
+    if (timers == NULL)
+        return -1;
+
+    return timer_cancel(timers, timer);
+}
+
+/**
+ * Sends a message whose reply goes to a new future. The future travels in an inline
+ * payload next to the message data, so the ask allocates nothing.
+ * @return              id of the future, o/w as push_message, -1 also if FUTURE_LIMIT asks are in flight
+ */
+long ask_message(actors_t *ac, actor_id_t actor, message_t message) {
+    int res;
+    long future;
+
+    if (message.message_type == MSG_GODIE || message.message_type == MSG_SPAWN)
+        return -2;
+
+    if ((future = future_acquire(ac->futures)) < 0)
+        return -1;
 
-    safe_unlock(&actor_temp->lock); // actor unlock
+    ask_t ask = { .data = message.data, .nbytes = message.nbytes, .future = future };
+    message_t queued = { .message_type = message.message_type | MESSAGE_ASK, .nbytes = sizeof(ask_t) };
 
-    if (add_to_queue) {
-        blocking_queue_push(AC.waiting, actor); // this queue is synchronised
+    if ((res = push_message(ac, actor, queued, &ask, 0)) != 0) {
+        future_release(ac->futures, future);
+        return res;
     }
 
-    return 0;
+    return future;
+}
+
+/// delivers a reply to the actor that asked for it with then_future
+static void run_continuation(future_continuation_t *then) {
+    push_message(then->system, then->actor, (message_t) {
+            .message_type = then->message_type,
+            .data = then->reply
+    }, NULL, PUSH_UNBOUNDED);
 }
 
 /**
- * This function is called by a thread from the pool, that has finished processing a callback.
- * Assumes that the parameter is correct
- * @param actor    - id of an actor that was being processed by a calling thread up until now
+ * Completes a future with a reply.
+ * @return              0 on success, -1 if the future is unknown, has got a reply already or has been given up
  */
-void computation_ended(actor_id_t actor) {
-    int messages_pending;
+int reply_future(actors_t *ac, long future, void *reply) {
+    future_continuation_t then;
+    int res = future_complete(ac->futures, future, reply, &then);
 
-    safe_lock(&AC.lock); // system lock
+    if (res == 1)
+        run_continuation(&then);
 
-#ifdef DEBUG
-    fprintf(stdout, "computation_ended %ld \n", actor);
-#endif
+    return res == 1 ? 0 : res;
+}
+
+/**
+ * Waits for the reply to a future, outside of actors.
+ * @return              as future_take
+ */
+int wait_future(actors_t *ac, long future, long timeout_ns, void **reply) {
+    return future_take(ac->futures, future, timeout_ns, reply);
+}
+
+/**
+ * Has the reply to a future sent to the calling actor, as a message of the given type.
+ * @return              0 on success, -1 if not called by an actor, -2 if the future is unknown
+ */
+int then_future(actors_t *ac, long future, message_type_t message_type) {
+    future_continuation_t now;
+    int res;
+
+    if (attached == NULL)
+        return -1;
+
+    if ((res = future_continue(ac->futures, future, attached, actor_id_self(), message_type, &now)) == 1)
+        run_continuation(&now);
+
+    return res == 1 ? 0 : res;
+}
+
+/**
+ * Gives a future up.
+ * @return              0 on success, -2 if the future is unknown
+ */
+int cancel_future(actors_t *ac, long future) {
+    return future_abandon(ac->futures, future);
+}
+
+/// future of the ask the calling callback is processing, -1 if there is none
+long current_future() {
+    return current_request;
+}
+
+/**
+ * Wakes up the senders waiting for room in the mailbox of an actor, called after
+ * messages of the actor have been taken while PENDING_WAITERS was set.
+ */
+static void wake_senders(actors_t *ac, actor_id_t actor, actor_t *actor_temp) {
+    int err;
+    space_waiter_t *w, *next;
+    waiter_stripe_t *stripe = &ac->stripes[id_index(actor) % WAITER_STRIPES];
+
+    safe_lock(&stripe->lock);
+
+    atomic_fetch_and(&actor_temp->pending, ~PENDING_WAITERS);
+    w = actor_temp->waiters;
+    actor_temp->waiters = NULL;
+
+    if ((err = pthread_cond_broadcast(&stripe->space)) != 0)
+        syserr(err, "cond broadcast failed");
+
+    safe_unlock(&stripe->lock);
+
+    for (; w != NULL; w = next) {
+        next = w->next;
+        push_message(ac, w->actor, (message_t) {
+                .message_type = w->message_type,
+                .nbytes = sizeof(actor_id_t),
+                .data = (void*) actor
+        }, NULL, PUSH_UNBOUNDED); // fails only if the waiter is gone
+        slab_free(w);
+    }
+}
+
+/**
+ * Replaces the empty mailbox of an actor, and its urgent lane if it has one, with queues allocated
+ * by the calling worker, so they come from its node. Called by the worker running the actor while
+ * PENDING_SHRINK keeps senders away.
+ */
+static void move_mailbox(actor_t *actor_temp, int node) {
+    queue_t *old = actor_temp->messages;
+    queue_t *urgent = atomic_load(&actor_temp->urgent);
 
-    actor_t* actor_temp = AC.actors[actor];
-    AC.n_processed_now--;
-    safe_unlock(&AC.lock); // system unlock
+    actor_temp->messages = queue_init();
+    queue_destroy(old);
 
-    safe_lock(&actor_temp->lock); // actor lock
-    actor_temp->processed_now = 0;
+    if (urgent != NULL) {
+        atomic_store(&actor_temp->urgent, queue_init());
+        queue_destroy(urgent);
+    }
 
-    messages_pending = !queue_empty(actor_temp->messages);
+    actor_temp->mailbox_node = node;
+}
 
-    // checks if an actor has finished its life
-    if (!messages_pending && actor_temp->goodbye) {
-        AC.n_finished++;
+/**
+ * This function is called by a thread from the pool, that has finished processing callbacks of an actor.
+ * Assumes that the parameter is correct
+ * @param c        - the last computation of an actor that was being processed by a calling thread up until now
+ */
+void computation_ended(actors_t *ac, computation_t *c) {
+    long pending;
+    int i;
+    actor_id_t actor = c->actor;
+
+    actor_t* actor_temp = actor_table_get(ac->actors, id_index(actor));
+
+    scheduler_busy(ac->waiting[attached_dispatcher], attached_worker, 0);
+
+#if CACTI_STATS
+    own_stats->idle_since = now_ns();
+    stats_add(own_stats, STATS_BUSY_NS, own_stats->idle_since - own_stats->active_since, 1);
+    stats_add(own_stats, STATS_ACTIVATIONS, 1, 1);
+    stats_add(own_stats, STATS_PROCESSED, (long) c->processed, 1);
+    atomic_store_explicit(&actor_temp->processed,
+                          atomic_load_explicit(&actor_temp->processed, memory_order_relaxed) + (long) c->processed,
+                          memory_order_relaxed);
+#endif
 
-        if (AC.n_finished == AC.num) {
-            blocking_queue_signal_all(AC.waiting);
+    pending = atomic_load(&actor_temp->pending);
+
+    queue_t *urgent = atomic_load(&actor_temp->urgent);
+    int node = own_node(ac, attached_dispatcher);
+
+    // a burst has drained, or the mailbox is on another node, and no sender is in the middle of a push:
+    // give the memory back, or allocate the mailbox anew on this worker's node
+    if ((queue_grown(actor_temp->messages) || (urgent != NULL && queue_grown(urgent))
+                || actor_temp->mailbox_node != node)
+            && (pending & PENDING_COUNT) == (long) c->processed
+            && !(pending & PENDING_CLOSED)
+            && atomic_compare_exchange_strong(&actor_temp->pending, &pending,
+                                              (pending - c->processed) | PENDING_SHRINK)) {
+        if (actor_temp->mailbox_node != node)
+            move_mailbox(actor_temp, node);
+        else {
+            queue_shrink(actor_temp->messages);
+            if (urgent != NULL)
+                queue_shrink(urgent);
         }
+        atomic_fetch_and(&actor_temp->pending, ~PENDING_SHRINK);
 
+        if (pending & PENDING_WAITERS)
+            wake_senders(ac, actor, actor_temp);
+        return;
     }
 
-    safe_unlock(&actor_temp->lock); // actor unlock
+    pending = atomic_fetch_sub(&actor_temp->pending, c->processed) - c->processed;
+
+    if (pending & PENDING_WAITERS)
+        wake_senders(ac, actor, actor_temp);
 
     // check if actor has pending messages and if so, add it to waiting queue
-    if (messages_pending) {
-        blocking_queue_push(AC.waiting, actor); // this queue is synchronised
+    if ((pending & PENDING_COUNT) != 0) {
+#if CACTI_LATENCY
+        atomic_store_explicit(&actor_temp->runnable_since, now_ns(), memory_order_relaxed);
+#endif
+        if (urgent != NULL && !queue_empty(urgent))
+            scheduler_push_urgent(ac->waiting[attached_dispatcher], actor);
+        else
+            scheduler_push(ac->waiting[attached_dispatcher], actor, -1); // stays on this worker, which is its home now
+
+    } else if (pending & PENDING_CLOSED) { // checks if an actor has finished its life
+        // senders fail on PENDING_CLOSED and waiters have just been woken up, the slot is ours
+        reclaim_actor(ac, actor, actor_temp, pending);
+
+        if (atomic_fetch_sub(&ac->n_alive, 1) == 1) {
+            for (i = 0; i < ac->n_dispatchers; ++i)
+                scheduler_interrupt(ac->waiting[i]);
+        }
     }
 
 }
 
 /**
- * A blocking function that waits until a computation is available and returns it.
- * @param[out] result    - pointer to a computation that must be handled by a calling thread
- * @return               - 0 if a next computation has been returned, -1 if all actors are done.
+ * Binds the calling thread to a run queue of a dispatcher of a system.
+ * @param dispatcher    - index of the dispatcher, 0 for the default one and i for config.dispatchers[i - 1]
+ * @param worker        - number of the calling thread in the dispatcher
  */
-int next_computation(computation_t *result) {
-    actor_id_t actor_id;
-    if (blocking_queue_pop(AC.waiting, &actor_id) != 0) { // blocking instruction
-        return -1;
+void attach_worker(actors_t *ac, int dispatcher, int worker) {
+    int i, slot = worker;
+
+    for (i = 0; i < dispatcher; ++i)
+        slot += ac->waiting[i]->n_workers;
+
+    attached            = ac;
+    attached_dispatcher = dispatcher;
+    attached_worker     = worker;
+    own_stats           = &ac->stats[slot];
+    own_stats->idle_since = now_ns();
+    own_latency         = ac->latency != NULL ? ac->latency[slot] : NULL;
+    scheduler_attach(ac->waiting[dispatcher], worker);
+
+#if CACTI_TRACE
+    char name[32];
+    snprintf(name, sizeof(name), "%s/%d", dispatcher == 0 ? "default" : ac->dispatchers[dispatcher], worker);
+    trace_name_thread(name);
+#endif
+}
+
+/**
+ * Takes the next message of an actor and prepares a computation for it.
+ * The message must have been reserved already.
+ */
+static void take_message(actor_t *actor_temp, actor_id_t actor_id, computation_t *result) {
+    message_t message;
+    long request = -1, sent_at = 0;
+    queue_t *popped = NULL;
+    stashed_t *stashed = actor_temp->coroutine == NULL ? actor_temp->stash_head : NULL;
+    queue_t *urgent = atomic_load(&actor_temp->urgent);
+
+    if (stashed != NULL) {
+        // messages kept while a callback was suspended are older than those in the mailbox
+        actor_temp->stash_head = stashed->next;
+        actor_temp->n_stashed--;
+        message = stashed->message;
+        if (stashed->shared)
+            message.message_type |= MESSAGE_SHARED;
+        request = stashed->request;
+        sent_at = stashed->sent_at;
+    } else {
+        // the message has been reserved, but its sender may not have linked it yet
+        while (popped == NULL) {
+            if (urgent != NULL && queue_pop(urgent, &message) == 0)
+                popped = urgent;
+            else if (queue_pop(actor_temp->messages, &message) == 0)
+                popped = actor_temp->messages;
+            else {
+                sched_yield();
+                urgent = atomic_load(&actor_temp->urgent);
+            }
+        }
+#if CACTI_LATENCY
+        sent_at = queue_stamp(popped);
+#endif
     }
 
-    // Computations shall continue
+    int shared  = (message.message_type & MESSAGE_SHARED) != 0;
+    int inlined = (message.message_type & MESSAGE_INLINE) != 0;
 
-#ifdef DEBUG
-    fprintf(stdout, "next_computation continues: %ld \n", actor_id);
-#endif
-    actor_t *actor_temp = AC.actors[actor_id]; // does not need to be synchronised
+    // the ask payload leaves the message as it was sent, and its future
+    if (message.message_type & MESSAGE_ASK) {
+        ask_t *ask = message.data;
+        request         = ask->future;
+        message.data    = ask->data;
+        message.nbytes  = ask->nbytes;
+        inlined         = 0;
+    }
+
+    message.message_type &= ~MESSAGE_FLAGS;
+
+    if (message.message_type == MSG_GODIE)
+        trace(TRACE_GODIE, TRACE_INSTANT, actor_id, 0);
 
-    safe_lock(&actor_temp->lock); // actor lock
-    message_t message = queue_pop(actor_temp->messages);
     size_t mt = message.message_type;
 
     if (mt == MSG_GODIE) {
-        actor_temp->goodbye = 1;
+        atomic_fetch_or(&actor_temp->pending, PENDING_CLOSED);
 
     } else if (mt >= actor_temp->role->nprompts && mt != MSG_SPAWN) {
         fatal("message_type out of range");
@@ -250,16 +1172,222 @@ int next_computation(computation_t *result) {
                     ? NULL : actor_temp->role->prompts[ message.message_type ]),
             .actor      = actor_id,
             .stateptr   = &actor_temp->stateptr,
-            .message    = message
+            .message    = message,
+            .processed  = result->processed + 1,
+            .started    = result->started,
+            .sent_at    = sent_at,
+            .waited     = result->waited,
+            .shared     = shared,
+            .inlined    = inlined,
+            .request    = request,
+            .stashed    = stashed
     };
     memcpy(result, &result_cpy, sizeof(computation_t));
+}
+
+/// keeps a message a suspended callback has not awaited for later, taking over its payload
+static void stash_message(actor_t *actor_temp, computation_t *c) {
+    stashed_t *stashed = slab_alloc(sizeof(stashed_t));
+
+    stashed->next    = NULL;
+    stashed->message = c->message;
+    stashed->shared  = c->shared;
+    stashed->request = c->request;
+    stashed->sent_at = c->sent_at;
+    c->shared        = 0;
+
+    // the mailbox keeps an inline payload only until the next message is taken
+    if (c->inlined) {
+        memcpy(stashed->payload, c->message.data, c->message.nbytes);
+        stashed->message.data = stashed->payload;
+    }
+
+    if (actor_temp->stash_head == NULL)
+        actor_temp->stash_head = stashed;
+    else
+        actor_temp->stash_tail->next = stashed;
+    actor_temp->stash_tail = stashed;
+    actor_temp->n_stashed++;
+}
+
+/**
+ * Runs the callback of a computation. Callbacks of coroutine roles run on coroutines: while one
+ * is suspended in actor_await, the message it waits for (or MSG_GODIE) resumes it and others
+ * are stashed. Stashed messages keep the actor scheduled only once no callback is suspended,
+ * so they are not counted in pending meanwhile.
+ */
+static void dispatch(actors_t *ac, computation_t *c) {
+    actor_t *actor_temp = actor_table_get(ac->actors, id_index(c->actor));
+    coroutine_t *co = actor_temp->coroutine;
+    message_type_t mt = c->message.message_type;
+
+    if (co == NULL) {
+        if (c->prompt == NULL)
+            return;
+
+        if (!actor_temp->role->coroutine || mt == MSG_SPAWN) {
+            current_request = c->request;
+            (*(c->prompt))(c->stateptr, c->message.nbytes, c->message.data);
+            current_request = -1;
+            return;
+        }
 
-    actor_temp->processed_now = 1;
-    safe_unlock(&actor_temp->lock); // actor unlock
+        co = coroutine_create(c->prompt, c->stateptr, c->message.nbytes, c->message.data, actor_temp);
+        actor_temp->request = c->request;
 
-    safe_lock(&AC.lock); // system lock
-    AC.n_processed_now++;
-    safe_unlock(&AC.lock); // system unlock
+    } else if (mt == MSG_SPAWN) {
+        (*(c->prompt))(c->stateptr, c->message.nbytes, c->message.data);
+        return;
+
+    } else if (mt == MSG_GODIE) {
+        actor_temp->await_result = -1;
+
+    } else if (mt == actor_temp->awaited) {
+        *actor_temp->received    = c->message;
+        actor_temp->await_result = 0;
+
+    } else {
+        stash_message(actor_temp, c);
+        return;
+    }
+
+    current_request = actor_temp->request;
+    int finished = coroutine_resume(co);
+    current_request = -1;
+
+    if (finished == 0) {
+        if (actor_temp->coroutine == NULL && actor_temp->n_stashed > 0)
+            atomic_fetch_sub(&actor_temp->pending, actor_temp->n_stashed);
+        actor_temp->coroutine = co;
+    } else {
+        if (actor_temp->coroutine != NULL && actor_temp->n_stashed > 0)
+            atomic_fetch_add(&actor_temp->pending, actor_temp->n_stashed);
+        actor_temp->coroutine = NULL;
+        coroutine_destroy(co);
+    }
+}
+
+/// runs a computation, between the dispatch events of the trace, and records its latencies
+void run_computation(actors_t *ac, computation_t *c) {
+#if CACTI_LATENCY
+    const role_t *role = ((actor_t*) actor_table_get(ac->actors, id_index(c->actor)))->role;
+    long start = now_ns();
+#endif
+
+    trace(TRACE_DISPATCH, TRACE_BEGIN, c->actor, c->message.message_type);
+    dispatch(ac, c);
+    trace(TRACE_DISPATCH, TRACE_END, c->actor, c->message.message_type);
+
+#if CACTI_LATENCY
+    latency_record(own_latency, role, c->message.message_type,
+                   c->sent_at != 0 ? start - c->sent_at : -1, c->waited, now_ns() - start);
+#endif
+}
+
+/**
+ * Suspends the calling coroutine until its actor gets a message of the given type.
+ * @return              0 on success, -1 if the actor has taken MSG_GODIE or there is no coroutine
+ */
+int await_message(message_type_t message_type, message_t *message) {
+    coroutine_t *co = coroutine_self();
+    actor_t *actor_temp;
+
+    if (co == NULL)
+        return -1;
+
+    actor_temp = co->owner;
+    if (atomic_load(&actor_temp->pending) & PENDING_CLOSED)
+        return -1;
+
+    actor_temp->awaited  = message_type;
+    actor_temp->received = message;
+    coroutine_yield();
+
+    return actor_temp->await_result;
+}
+
+/**
+ * A blocking function that waits until a computation is available and returns it.
+ * @param worker         - number of the calling thread in the dispatcher it is attached to
+ * @param[out] result    - pointer to a computation that must be handled by a calling thread
+ * @return               - 0 if a next computation has been returned, -1 if all actors are done.
+ */
+int next_computation(actors_t *ac, int worker, computation_t *result) {
+    actor_id_t actor_id;
+    int res = scheduler_pop(ac->waiting[attached_dispatcher], worker, &actor_id); // blocking instruction
+    long now = now_ns();
+
+#if CACTI_STATS
+    own_stats->active_since = now;
+    stats_add(own_stats, STATS_IDLE_NS, own_stats->active_since - own_stats->idle_since, 1);
+#endif
+
+    if (res != 0)
+        return -1;
+
+    scheduler_busy(ac->waiting[attached_dispatcher], worker, now);
+
+    // Computations shall continue
+
+    actor_t *actor_temp = actor_table_get(ac->actors, id_index(actor_id));
+
+    // the actor sticks to this worker from now on
+    int home = atomic_load_explicit(&actor_temp->home, memory_order_relaxed);
+    if (home != worker) {
+        atomic_store_explicit(&actor_temp->home, worker, memory_order_relaxed);
+        if (home >= 0)
+            atomic_fetch_add_explicit(&actor_temp->migrations, 1, memory_order_relaxed);
+    }
+
+#if CACTI_STATS
+    long depth = atomic_load_explicit(&actor_temp->pending, memory_order_relaxed) & PENDING_COUNT;
+    stats_max(own_stats, STATS_HIGH_WATER, depth);
+    if (depth > atomic_load_explicit(&actor_temp->high_water, memory_order_relaxed))
+        atomic_store_explicit(&actor_temp->high_water, depth, memory_order_relaxed);
+#endif
+
+    result->processed = 0;
+    result->started   = ac->quota_ns != 0 ? now : 0;
+#if CACTI_LATENCY
+    result->waited    = now_ns() - atomic_load_explicit(&actor_temp->runnable_since, memory_order_relaxed);
+#else
+    result->waited    = -1;
+#endif
+    take_message(actor_temp, actor_id, result);
+    return 0;
+}
+
+/**
+ * Keeps the calling thread on the same actor: takes its next message as long as the actor
+ * has one and has not used up its quota of messages or time in this activation.
+ * @param[in,out] c      - the computation just finished, replaced by the next one
+ * @return               - 0 if a next computation has been returned, -1 if the actor should be released
+ */
+int continue_computation(actors_t *ac, computation_t *c) {
+    actor_t *actor_temp = actor_table_get(ac->actors, id_index(c->actor));
+    size_t quota = actor_temp->role->quota != 0 ? actor_temp->role->quota : ac->quota;
+
+    // the callback has returned, or has been suspended
+    if (c->shared) {
+        release_shared(c->message.data, 1);
+        c->shared = 0;
+    }
+    if (c->stashed != NULL) {
+        slab_free(c->stashed);
+        c->stashed = NULL;
+    }
+
+    if (c->processed >= quota || atomic_load_explicit(&ac->interrupted, memory_order_relaxed))
+        return -1;
+
+    if ((size_t)(atomic_load(&actor_temp->pending) & PENDING_COUNT) <= c->processed)
+        return -1; // nothing more has been sent
+
+    if (ac->quota_ns != 0 && now_ns() - c->started >= ac->quota_ns)
+        return -1;
+
+    c->waited = -1;
+    take_message(actor_temp, c->actor, c);
     return 0;
 }
 
@@ -267,38 +1395,196 @@ int next_computation(computation_t *result) {
  * Marks all system of actors as if all actors do not accept signals anymore
  * which causes threads to end as soon as they finish currently executed callback.
  */
-void interrupt_all() {
-    safe_lock(&AC.lock); // system lock
-    AC.interrupted = 1;
-    blocking_queue_signal_all(AC.waiting);
-    safe_unlock(&AC.lock); // system unlock
+void interrupt_all(actors_t *ac) {
+    int i, err;
+
+    atomic_store(&ac->interrupted, 1);
+    for (i = 0; i < ac->n_dispatchers; ++i)
+        scheduler_interrupt(ac->waiting[i]);
+
+    // senders waiting for room give up
+    for (i = 0; i < WAITER_STRIPES; ++i) {
+        safe_lock(&ac->stripes[i].lock);
+        if ((err = pthread_cond_broadcast(&ac->stripes[i].space)) != 0)
+            syserr(err, "cond broadcast failed");
+        safe_unlock(&ac->stripes[i].lock);
+    }
+}
+
+/// the latency histograms of all workers of a system added up in a new table
+static latency_table_t* merge_latency(actors_t *ac) {
+    int i;
+    latency_table_t *merged = latency_table_init();
+
+    for (i = 0; i < ac->n_stats - 1; ++i)
+        latency_merge(merged, ac->latency[i]);
+    return merged;
+}
+
+/**
+ * Merges the latency histograms of all workers and exports their percentiles.
+ * @param[out] stats    - up to n pairs of a role and a message type, of the last system destroyed if ac is NULL
+ * @return              - the number of pairs recorded
+ */
+size_t latency_snapshot(actors_t *ac, latency_stats_t *stats, size_t n) {
+    size_t found;
+    latency_table_t *merged;
+
+    if (ac == NULL)
+        return last_latency != NULL ? latency_export(last_latency, stats, n) : 0;
+    if (ac->latency == NULL)
+        return 0;
+
+    merged = merge_latency(ac);
+    found  = latency_export(merged, stats, n);
+    latency_table_destroy(merged);
+    return found;
+}
+
+/**
+ * Sums up how idle workers of all dispatchers spent their time.
+ * @param[out] stats    - stats of the system, or of the last one destroyed if ac is NULL
+ */
+void idle_stats(actors_t *ac, idle_stats_t *stats) {
+    int i;
+    idle_stats_t one;
+
+    if (ac == NULL) {
+        *stats = last_idle_stats;
+        return;
+    }
+
+    *stats = (idle_stats_t) { 0 };
+    for (i = 0; i < ac->n_dispatchers; ++i) {
+        scheduler_idle_stats(ac->waiting[i], &one);
+        stats->workers     += one.workers;
+        stats->spin_budget += one.spin_budget;
+        stats->spin_hits   += one.spin_hits;
+        stats->parks       += one.parks;
+        stats->wakeups     += one.wakeups;
+    }
+}
+
+/**
+ * Sums up the counters of all workers, without stopping them.
+ * @param[out] stats    - counters of the system, or of the last one destroyed if ac is NULL
+ */
+void stats_snapshot(actors_t *ac, cacti_stats_t *stats) {
+    int i;
+
+    if (ac == NULL) {
+        *stats = last_stats;
+        return;
+    }
+
+    *stats = (cacti_stats_t) { .workers = ac->n_stats - 1, .alive = atomic_load(&ac->n_alive) };
+    for (i = 0; i < ac->n_stats; ++i) {
+        stats_slot_t *slot = &ac->stats[i];
+        stats->sent        += stats_get(slot, STATS_SENT);
+        stats->rejected    += stats_get(slot, STATS_REJECTED);
+        stats->processed   += stats_get(slot, STATS_PROCESSED);
+        stats->activations += stats_get(slot, STATS_ACTIVATIONS);
+        stats->busy_ns     += stats_get(slot, STATS_BUSY_NS);
+        stats->idle_ns     += stats_get(slot, STATS_IDLE_NS);
+        if (stats_get(slot, STATS_HIGH_WATER) > stats->mailbox_high_water)
+            stats->mailbox_high_water = stats_get(slot, STATS_HIGH_WATER);
+    }
+
+    for (i = 0; i < ac->n_dispatchers; ++i)
+        stats->run_queue += scheduler_length(ac->waiting[i]);
+
+    idle_stats(ac, &stats->idle);
+}
+
+/// pops messages nobody will process, releasing their shared payloads
+static void drain(queue_t *q) {
+    message_t ignored;
+
+    while (queue_pop(q, &ignored) == 0)
+        if (ignored.message_type & MESSAGE_SHARED)
+            release_shared(ignored.data, 1);
 }
 
 /**
- * Deallocates everything it allocated. Should be run only after all actors are done.
+ * Deallocates the system. Should be run only after its workers have returned.
  * @return
  */
-int messages_destroy() {
-    int err, i;
+int messages_destroy(actors_t *ac) {
+    long i;
+    int err;
+    space_waiter_t *w, *next;
+    timer_service_t *timers = atomic_load(&ac->timers);
+
+    // stop timers before the run queues they push to
+    if (timers != NULL)
+        timer_service_destroy(timers);
+
+    // destroy run queues
+    idle_stats(ac, &last_idle_stats);
+    stats_snapshot(ac, &last_stats);
+    if (ac->latency != NULL) {
+        if (last_latency != NULL)
+            latency_table_destroy(last_latency);
+        last_latency = merge_latency(ac);
+    }
+    for (i = 0; i < ac->n_dispatchers; ++i) {
+        scheduler_destroy(ac->waiting[i]);
+        free(ac->dispatchers[i]);
+    }
+    free(ac->waiting);
+    free(ac->dispatchers);
+
+    // destroy queues associated with actors
+    for (i = 0; i < actor_table_size(ac->actors); ++i) {
+        actor_t *actor_temp = actor_table_get(ac->actors, i);
+        if (actor_temp == NULL || !(atomic_load(&actor_temp->pending) & PENDING_OPEN))
+            continue;
+
+        // an interrupted system may leave messages behind
+        drain(actor_temp->messages);
+        queue_destroy(actor_temp->messages);
+
+        queue_t *urgent = atomic_load(&actor_temp->urgent);
+        if (urgent != NULL) {
+            drain(urgent);
+            queue_destroy(urgent);
+        }
 
-    // destroy main mutex
-    if ((err = pthread_mutex_destroy(&AC.lock)) != 0)
-        syserr(err, "mutex destroy failed");
+        for (w = actor_temp->waiters; w != NULL; w = next) {
+            next = w->next;
+            slab_free(w);
+        }
 
-    // destroy major queue
-    blocking_queue_destroy(AC.waiting);
+        // a callback suspended in an interrupted system never resumes
+        if (actor_temp->coroutine != NULL)
+            coroutine_destroy(actor_temp->coroutine);
 
-    // destroy minor mutexes and queues associated with actors
-    for (i = 0; i < AC.num; ++i) {
-        queue_destroy(AC.actors[i]->messages);
-        if ((err = pthread_mutex_destroy(&AC.actors[i]->lock)) != 0) {
-            syserr(err, "mutex destroy failed");
+        while (actor_temp->stash_head != NULL) {
+            stashed_t *stashed = actor_temp->stash_head;
+            actor_temp->stash_head = stashed->next;
+            if (stashed->shared)
+                release_shared(stashed->message.data, 1);
+            slab_free(stashed);
         }
-        free(AC.actors[i]);
     }
 
-    // destroy the list of actors
-    free(AC.actors);
+    for (i = 0; i < WAITER_STRIPES; ++i) {
+        if ((err = pthread_cond_destroy(&ac->stripes[i].space)) != 0)
+            syserr(err, "cond destroy failed");
+        if ((err = pthread_mutex_destroy(&ac->stripes[i].lock)) != 0)
+            syserr(err, "mutex destroy failed");
+    }
+
+    // destroy the table of actors
+    actor_table_destroy(ac->actors);
+    future_pool_destroy(ac->futures);
+    free(ac->stats);
+    if (ac->latency != NULL) {
+        for (i = 0; i < ac->n_stats - 1; ++i)
+            latency_table_destroy(ac->latency[i]);
+        free(ac->latency);
+    }
+    free(ac);
 
     return 0;
 }
\ No newline at end of file
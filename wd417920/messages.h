@@ -3,6 +3,12 @@
 
 #include "cacti.h"
 
+#define PUSH_UNBOUNDED  1               ///< push_message ignores the mailbox limit
+#define PUSH_URGENT     2               ///< push_message uses the urgent lane
+
+/// actors of a single system together with their run queues
+typedef struct actors actors_t;
+
 typedef struct computation {
     actor_id_t actor;
 
@@ -10,18 +16,72 @@ typedef struct computation {
     void **stateptr;
 
     message_t message;
+
+    size_t processed;   ///< number of messages of the actor taken during this activation
+    long started;       ///< start of the activation in nanoseconds, set only if activations have a time budget
+    long sent_at;       ///< time the message was pushed into the mailbox, 0 unless CACTI_LATENCY is set
+    long waited;        ///< nanoseconds the actor waited for a worker before this message, -1 if it did not
+    int shared;         ///< 1 if message.data is a multicast payload to be released after the callback
+    int inlined;        ///< 1 if message.data points into the mailbox
+    long request;       ///< future of an ask, -1 for other messages
+    void *stashed;      ///< the stash entry message.data may point into, freed after the callback
 } computation_t;
 
-extern int init_actors_system(actor_id_t *actor, role_t *role);
+extern actors_t* init_actors_system(actor_id_t *actor, role_t *role, const actor_system_config_t *config,
+                                    const int *node);
+
+extern int spawn_actors(actors_t *ac, role_t *role, const char *dispatcher, size_t n, void *const *states,
+                        actor_id_t *ids);
+
+extern int push_message(actors_t *ac, actor_id_t actor, message_t message, const void *payload, int flags);
+
+extern size_t multicast(actors_t *ac, const actor_id_t *actors, size_t n, message_type_t message_type,
+                        const void *payload, size_t nbytes, int *results);
+
+extern int push_message_timed(actors_t *ac, actor_id_t actor, message_t message, long timeout_ns);
+
+extern int notify_on_space(actor_id_t actor, message_type_t message_type);
+
+extern long actor_migrations_of(actors_t *ac, actor_id_t actor);
+
+extern int actor_stats_of(actors_t *ac, actor_id_t actor, actor_stats_t *stats);
+
+extern long schedule_message(actors_t *ac, actor_id_t actor, message_t message, long delay_ns, long period_ns);
+
+extern int cancel_scheduled(actors_t *ac, long timer);
+
+extern long ask_message(actors_t *ac, actor_id_t actor, message_t message);
+
+extern int reply_future(actors_t *ac, long future, void *reply);
+
+extern int wait_future(actors_t *ac, long future, long timeout_ns, void **reply);
+
+extern int then_future(actors_t *ac, long future, message_type_t message_type);
+
+extern int cancel_future(actors_t *ac, long future);
+
+extern long current_future();
+
+extern void attach_worker(actors_t *ac, int dispatcher, int worker);
+
+extern int next_computation(actors_t *ac, int worker, computation_t* c);
+
+extern void run_computation(actors_t *ac, computation_t* c);
+
+extern int await_message(message_type_t message_type, message_t *message);
+
+extern int continue_computation(actors_t *ac, computation_t* c);
+
+extern void computation_ended(actors_t *ac, computation_t* c);
 
-extern int send_message(actor_id_t actor, message_t message);
+extern void interrupt_all(actors_t *ac);
 
-extern int next_computation(computation_t* c);
+extern void idle_stats(actors_t *ac, idle_stats_t *stats);
 
-extern void computation_ended(actor_id_t actor);
+extern void stats_snapshot(actors_t *ac, cacti_stats_t *stats);
 
-extern void interrupt_all();
+extern size_t latency_snapshot(actors_t *ac, latency_stats_t *stats, size_t n);
 
-extern int messages_destroy();
+extern int messages_destroy(actors_t *ac);
 
 #endif //MESSAGES_H
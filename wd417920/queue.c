@@ -1,65 +1,252 @@
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "queue.h"
 #include "err.h"
 #include "cacti.h"
+#include "slab.h"
+
+#define NO_NODE UINT32_MAX
+
+/// number of the chunk a node index falls into, 0 for inline nodes
+static inline int chunk_of(uint32_t index) {
+    if (index < QUEUE_INLINE_NODES)
+        return 0;
+    return (31 - __builtin_clz(index)) - __builtin_ctz(QUEUE_INLINE_NODES) + 1;
+}
+
+/// index of the first node of a chunk, which is also the length of chunk > 0
+static inline uint32_t chunk_start(int chunk) {
+    return chunk == 0 ? 0 : (uint32_t) QUEUE_INLINE_NODES << (chunk - 1);
+}
+
+static inline queue_node_t* node_at(queue_t* q, uint32_t index) {
+    int chunk = chunk_of(index);
+
+    if (chunk == 0)
+        return &q->nodes[index];
+
+    queue_node_t *base = atomic_load_explicit(&atomic_load_explicit(&q->chunks, memory_order_acquire)[chunk],
+            memory_order_acquire);
+    return base + (index - chunk_start(chunk));
+}
+
+static inline uint64_t free_head(uint64_t old, uint32_t index) {
+    return (((old >> 32) + 1) << 32) | index;
+}
+
+/**
+ * Puts a list of nodes, linked by next_free, on the free list.
+ */
+static void release_nodes(queue_t* q, queue_node_t* first, queue_node_t* last) {
+    uint64_t old = atomic_load_explicit(&q->free, memory_order_relaxed);
+
+    do {
+        atomic_store_explicit(&last->next_free, (uint32_t) old, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&q->free, &old, free_head(old, first->index),
+            memory_order_release, memory_order_relaxed));
+}
+
+/**
+ * Allocates the next chunk when the free list ran dry.
+ * @param chunk     number of the chunk to be allocated
+ * @return          a node of the new chunk, NULL if another thread has grown the pool meanwhile
+ */
+static queue_node_t* grow(queue_t* q, int chunk) {
+    uint32_t i, length;
+    queue_node_t* _Atomic *chunks = atomic_load_explicit(&q->chunks, memory_order_acquire);
+
+    if (chunks == NULL) {
+        queue_node_t* _Atomic *created = slab_alloc(QUEUE_CHUNKS * sizeof(queue_node_t*));
+        memset(created, 0, QUEUE_CHUNKS * sizeof(queue_node_t*));
+
+        if (atomic_compare_exchange_strong(&q->chunks, &chunks, created))
+            chunks = created;
+        else
+            slab_free(created);
+    }
+
+    if (chunk >= QUEUE_CHUNKS)
+        fatal("queue pool exhausted");
+
+    if (atomic_load_explicit(&chunks[chunk], memory_order_acquire) != NULL)
+        return NULL;
+
+    length = chunk_start(chunk);
+    queue_node_t *expected = NULL, *created = slab_alloc(length * sizeof(queue_node_t));
+
+    for (i = 0; i < length; ++i) {
+        created[i].index = chunk_start(chunk) + i;
+        atomic_init(&created[i].next_free, created[i].index + 1);
+    }
+
+    if (!atomic_compare_exchange_strong(&chunks[chunk], &expected, created)) {
+        slab_free(created);
+        return NULL;
+    }
+
+    // keep the first node, share the rest
+    if (length > 1)
+        release_nodes(q, &created[1], &created[length - 1]);
+    atomic_fetch_add(&q->grown, 1);
+
+    return &created[0];
+}
+
+static queue_node_t* acquire_node(queue_t* q) {
+    uint32_t grown = atomic_load(&q->grown);
+    uint64_t old = atomic_load_explicit(&q->free, memory_order_acquire);
+    queue_node_t *node;
+
+    while (1) {
+        if ((uint32_t) old == NO_NODE) {
+            // the pool is grown by the chunk that was missing when the list was seen empty
+            if ((node = grow(q, grown + 1)) != NULL)
+                return node;
+            grown = atomic_load(&q->grown);
+            old = atomic_load_explicit(&q->free, memory_order_acquire);
+            continue;
+        }
+
+        node = node_at(q, (uint32_t) old);
+        uint32_t next = atomic_load_explicit(&node->next_free, memory_order_relaxed);
+
+        if (atomic_compare_exchange_weak_explicit(&q->free, &old, free_head(old, next),
+                memory_order_acquire, memory_order_acquire))
+            return node;
+    }
+}
+
+/// links all inline nodes but the stub into the free list
+static void reset_inline(queue_t* q, uint64_t old_free) {
+    int i;
+
+    for (i = 0; i < QUEUE_INLINE_NODES; ++i) {
+        q->nodes[i].index = i;
+        atomic_store_explicit(&q->nodes[i].next, NULL, memory_order_relaxed);
+        atomic_store_explicit(&q->nodes[i].next_free,
+                i + 1 < QUEUE_INLINE_NODES ? (uint32_t) i + 1 : NO_NODE, memory_order_relaxed);
+    }
+
+    q->front = &q->nodes[0];
+    atomic_store(&q->back, &q->nodes[0]);
+    atomic_store(&q->free, free_head(old_free, QUEUE_INLINE_NODES > 1 ? 1 : NO_NODE));
+}
 
 queue_t* queue_init() {
-    //queue_t *q = (queue_t*) malloc(sizeof(queue_t));
-    //if (q == NULL)
-    //    return NULL;
-
-    queue_t *q = (queue_t*) safe_malloc(sizeof(queue_t));
-    q->len      = 0;
-    q->capacity = ACTOR_QUEUE_LIMIT;
-    q->list     = safe_malloc(sizeof(content_t) * q->capacity);
-    q->back     = 0;
-    q->front    = 0;
+    queue_t *q = (queue_t*) slab_alloc(sizeof(queue_t)); // bigger than a cache line, so aligned
+
+    atomic_init(&q->chunks, NULL);
+    atomic_init(&q->grown, 0);
+    atomic_init(&q->free, 0);
+    atomic_init(&q->back, NULL);
+    reset_inline(q, 0);
     return q;
 }
 
 int queue_empty(queue_t* q) {
-  return q->len == 0;
+    return atomic_load_explicit(&q->front->next, memory_order_acquire) == NULL;
 }
 
-//static void extend_queue(queue_t* q) {
-//    capacity
+#if CACTI_LATENCY
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+#endif
 
-//}
+/// links a node filled by the caller at the back
+static void link_node(queue_t* q, queue_node_t *node) {
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+#if CACTI_LATENCY
+    node->stamp = now_ns();
+#else
+    node->stamp = 0;
+#endif
+
+    // from now on node is the back, but the consumer can reach it only once prev is linked
+    queue_node_t *prev = atomic_exchange_explicit(&q->back, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
 
 int queue_push(queue_t* q, content_t data) {
-    if (q->len == q->capacity) {
-        //if (q->capacity * 2 <= ACTOR_QUEUE_LIMIT) {
-        //    void extend_queue(q);
-        //} else {
-            // fatal("queue limit reached");
-            return -1;
-        //}
-    }
+    queue_node_t *node = acquire_node(q);
+    if (node == NULL)
+        return -1;
 
-    q->list[ q->back ] = data;
-    q->back = (q->back + 1) % q->capacity;
-    q->len++;
+    node->data        = data;
+    node->has_payload = 0;
+    link_node(q, node);
 
     return 0;
 }
 
-/** queue must not be empty */
-content_t queue_pop(queue_t* q) {
-    if (queue_empty(q)) {
-        fatal("queue is empty");
-    }
+int queue_push_inline(queue_t* q, content_t data, const void *payload) {
+    if (data.nbytes > MESSAGE_INLINE_MAX)
+        return -1;
+
+    queue_node_t *node = acquire_node(q);
+    if (node == NULL)
+        return -1;
+
+    memcpy(node->payload, payload, data.nbytes);
+    node->data        = data;
+    node->has_payload = 1;
+    link_node(q, node);
+
+    return 0;
+}
+
+int queue_pop(queue_t* q, content_t* data) {
+    queue_node_t *front = q->front;
+    queue_node_t *next  = atomic_load_explicit(&front->next, memory_order_acquire);
+
+    if (next == NULL)
+        return -1;
+
+    // next becomes the new stub, its payload lives until it is released by the next pop
+    *data    = next->data;
+    if (next->has_payload)
+        data->data = next->payload;
+    q->front = next;
+    release_nodes(q, front, front);
+
+    return 0;
+}
+
+long queue_stamp(queue_t* q) {
+    // the popped node is the stub now
+    return q->front->stamp;
+}
+
+int queue_grown(queue_t* q) {
+    return (int) atomic_load_explicit(&q->grown, memory_order_relaxed);
+}
+
+int queue_shrink(queue_t* q) {
+    int chunk;
+    queue_node_t* _Atomic *chunks = atomic_load(&q->chunks);
+
+    if (chunks == NULL)
+        return 0;
+
+    reset_inline(q, atomic_load(&q->free));
 
-    content_t res = q->list[ q->front ];
-    q->front = (q->front + 1) % q->capacity;
-    q->len--;
+    for (chunk = 1; chunk < QUEUE_CHUNKS; ++chunk)
+        slab_free(atomic_load(&chunks[chunk]));
+    slab_free(chunks);
+    atomic_store(&q->chunks, NULL);
+    atomic_store(&q->grown, 0);
 
-    return res;
+    return 1;
 }
 
 int queue_destroy(queue_t* q) {
     if (queue_empty(q)) {
-        free(q);
+        queue_shrink(q);
+        slab_free(q);
         return 0;
     }
 
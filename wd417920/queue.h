@@ -1,34 +1,91 @@
-// Unsynchronised module
+// Lock-free multi-producer single-consumer queue (Vyukov).
+// Any thread may push, only one thread at a time may pop.
+//
+// Nodes come from a pool owned by the queue: a few inline nodes, then chunks
+// twice as big as all the nodes before them. Chunks are freed by queue_shrink
+// once a burst has drained.
 
 #ifndef QUEUE_H
 #define QUEUE_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include "cacti.h"
+#include "err.h"
+
+#define QUEUE_INLINE_NODES 4    ///< nodes living inside queue_t, one of them is always the stub
+#define QUEUE_CHUNKS 32         ///< chunk k > 0 holds QUEUE_INLINE_NODES << (k - 1) nodes
 
 typedef message_t content_t;
 
+typedef struct queue_node {
+    struct queue_node* _Atomic next;    ///< next node of the queue
+    _Atomic uint32_t next_free;         ///< next node of the free list, by index
+    uint32_t index;                     ///< position of the node in the pool
+    content_t data;
+    int has_payload;                    ///< 1 if data.data should point to payload once popped
+    long stamp;                         ///< monotonic time of the push in nanoseconds, 0 unless CACTI_LATENCY is set
+    _Alignas(max_align_t) unsigned char payload[MESSAGE_INLINE_MAX];
+} queue_node_t;
+
 typedef struct queue {
-    volatile size_t len;
-    volatile size_t capacity;
-    content_t* list;
-    size_t volatile back;
-    size_t volatile front;
+    _Alignas(CACHE_LINE) queue_node_t* _Atomic back;        ///< most recently pushed node, shared by producers
+    _Atomic uint64_t free;                                  ///< free list: ABA tag in high, index of top node in low half
+    queue_node_t* _Atomic * _Atomic chunks;                 ///< QUEUE_CHUNKS pointers, allocated with the first chunk
+    _Atomic uint32_t grown;                                 ///< number of chunks allocated
+
+    _Alignas(CACHE_LINE) queue_node_t* front;               ///< stub node preceding the first element, consumer only
+    queue_node_t nodes[QUEUE_INLINE_NODES];
 } queue_t;
 
 extern queue_t* queue_init();
 
+/**
+ * Checks if there is an element the consumer could pop. May be called only by the consumer.
+ * A push that is still in progress is not visible yet.
+ */
 extern int queue_empty(queue_t* q);
 
 /**
- * Push back.
+ * Push back. Lock-free, may be called by any thread.
  * @param q     - pointer to a queue
  * @param data  - data to be inserted
  * @return      0 on success, -1 on failure
  */
 extern int queue_push(queue_t* q, content_t data);
 
-extern content_t queue_pop(queue_t* q);
+/**
+ * Push back with data.nbytes bytes of payload copied into the node.
+ * Lock-free, may be called by any thread.
+ * @param q         - pointer to a queue
+ * @param data      - data to be inserted, its pointer is ignored
+ * @param payload   - at most MESSAGE_INLINE_MAX bytes to be copied
+ * @return          0 on success, -1 on failure
+ */
+extern int queue_push_inline(queue_t* q, content_t data, const void *payload);
+
+/**
+ * Pop front. May be called only by the consumer. The payload of an element pushed
+ * with queue_push_inline stays in the queue until the next pop or shrink.
+ * @param q             - pointer to a queue
+ * @param[out] data     - removed element, pointing to its payload if it has one
+ * @return              0 on success, -1 if no element is visible yet
+ */
+extern int queue_pop(queue_t* q, content_t* data);
+
+/// time the element popped last was pushed, in nanoseconds of CLOCK_MONOTONIC, 0 if not known
+extern long queue_stamp(queue_t* q);
+
+/// number of chunks allocated, 0 if the queue uses only inline nodes
+extern int queue_grown(queue_t* q);
+
+/**
+ * Frees all chunks, leaving only the inline nodes. May be called only by the consumer,
+ * when the queue is empty and no push is in progress.
+ * @return      1 if any memory was freed, 0 o/w
+ */
+extern int queue_shrink(queue_t* q);
 
 extern int queue_destroy(queue_t* q);
 
@@ -0,0 +1,474 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "scheduler.h"
+#include "trace.h"
+#include "err.h"
+
+static __thread scheduler_t *attached = NULL;   ///< scheduler the calling thread works for
+static __thread int attached_worker = -1;       ///< number of the calling worker
+static __thread unsigned int victim_seed = 1;   ///< state of the victim generator
+static __thread unsigned int ticks = 0;         ///< number of scheduler_pop calls of the worker
+
+scheduler_t* scheduler_init(int n_workers, const int *node) {
+    int i;
+    scheduler_t *s = safe_malloc(sizeof(scheduler_t));
+
+    s->n_workers = n_workers;
+    s->n_nodes   = 1;
+    s->node      = safe_malloc(n_workers * sizeof(int));
+    s->deques    = safe_malloc(n_workers * sizeof(deque_t*));
+    s->inboxes   = safe_aligned_malloc(n_workers * sizeof(worker_inbox_t));
+    s->injected  = blocking_queue_init();
+    s->urgent    = blocking_queue_init();
+    s->idle      = safe_aligned_malloc(n_workers * sizeof(worker_idle_t));
+
+    if (s->injected == NULL || s->urgent == NULL)
+        fatal("blocking queue init failed");
+
+    for (i = 0; i < n_workers; ++i) {
+        s->node[i]   = node != NULL ? node[i] : 0;
+        s->n_nodes   = s->node[i] >= s->n_nodes ? s->node[i] + 1 : s->n_nodes;
+        s->deques[i] = deque_init();
+        if ((s->inboxes[i].queue = blocking_queue_init()) == NULL)
+            fatal("blocking queue init failed");
+        atomic_init(&s->inboxes[i].length, 0);
+        atomic_init(&s->idle[i].spin_budget, SCHEDULER_SPIN_MIN);
+        atomic_init(&s->idle[i].spin_hits, 0);
+        atomic_init(&s->idle[i].parks, 0);
+        atomic_init(&s->idle[i].wakeups, 0);
+        atomic_init(&s->idle[i].parked, 0);
+        atomic_init(&s->idle[i].busy_since, 0);
+    }
+
+    atomic_init(&s->next_placed, 0);
+
+    atomic_init(&s->n_injected, 0);
+    atomic_init(&s->n_urgent, 0);
+    atomic_init(&s->wake_seq, 0);
+    atomic_init(&s->sleeping, 0);
+    atomic_init(&s->spinning, 0);
+    atomic_init(&s->interrupted, 0);
+
+    return s;
+}
+
+void scheduler_attach(scheduler_t *s, int worker) {
+    attached        = s;
+    attached_worker = worker;
+    victim_seed     = (unsigned int) worker * 2654435761u + 1;
+}
+
+/// xorshift, good enough to spread thieves over victims
+static inline unsigned int next_victim(int n_workers) {
+    victim_seed ^= victim_seed << 13;
+    victim_seed ^= victim_seed >> 17;
+    victim_seed ^= victim_seed << 5;
+    return victim_seed % n_workers;
+}
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/// sleeps while the word holds the expected value, at most timeout_ns if it is not negative
+static void futex_wait(atomic_uint *word, unsigned int expected, long timeout_ns) {
+    struct timespec timeout = { .tv_sec = timeout_ns / 1000000000L, .tv_nsec = timeout_ns % 1000000000L };
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, timeout_ns >= 0 ? &timeout : NULL, NULL, 0);
+}
+
+/// wakes up n workers parked on wake_seq
+static void wake(scheduler_t *s, int n) {
+    atomic_fetch_add(&s->wake_seq, 1);
+    syscall(SYS_futex, &s->wake_seq, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+/// pushes onto one of the shared queues, counting its length
+static void push_shared(blocking_queue_t *bq, atomic_long *length, actor_id_t actor) {
+    if (blocking_queue_push(bq, actor) != 0)
+        fatal("blocking queue push failed");
+    atomic_fetch_add(length, 1);
+}
+
+/// takes an actor from one of the shared queues, without locking it if it looks empty
+static int pop_shared(blocking_queue_t *bq, atomic_long *length, actor_id_t *actor) {
+    if (atomic_load_explicit(length, memory_order_relaxed) <= 0
+            || blocking_queue_try_pop(bq, actor) != 0)
+        return -1;
+
+    atomic_fetch_sub(length, 1);
+    return 0;
+}
+
+/// wakes a parked worker for a pushed actor, unless a spinning one will take it
+static void wake_for_push(scheduler_t *s) {
+    // pairs with the fences in spin() and park(), either we see the spinner or sleeper,
+    // or it sees the actor
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&s->spinning, memory_order_relaxed) == 0
+            && atomic_load_explicit(&s->sleeping, memory_order_relaxed) > 0)
+        wake(s, 1);
+}
+
+/// wakes parked workers for a batch of n pushed actors, as many as the spinners will not take
+static void wake_for_batch(scheduler_t *s, size_t n) {
+    atomic_thread_fence(memory_order_seq_cst);
+
+    long sleeping = atomic_load_explicit(&s->sleeping, memory_order_relaxed);
+    long missing  = (long) n - atomic_load_explicit(&s->spinning, memory_order_relaxed);
+
+    if (sleeping > 0 && missing > 0)
+        wake(s, (int) (missing < sleeping ? missing : sleeping));
+}
+
+/// puts an actor on the run queue scheduler_push picks for it, without waking anybody
+static void push_runnable(scheduler_t *s, actor_id_t actor, int worker) {
+    trace(TRACE_SCHEDULE, TRACE_INSTANT, actor, 0);
+
+    if (attached == s && (worker < 0 || worker == attached_worker))
+        deque_push(s->deques[attached_worker], actor);
+    else if (worker >= 0)
+        push_shared(s->inboxes[worker].queue, &s->inboxes[worker].length, actor);
+    else
+        push_shared(s->injected, &s->n_injected, actor);
+}
+
+void scheduler_push(scheduler_t *s, actor_id_t actor, int worker) {
+    push_runnable(s, actor, worker);
+    wake_for_push(s);
+}
+
+void scheduler_push_urgent(scheduler_t *s, actor_id_t actor) {
+    trace(TRACE_SCHEDULE, TRACE_INSTANT, actor, 1);
+    push_shared(s->urgent, &s->n_urgent, actor);
+    wake_for_push(s);
+}
+
+void scheduler_push_many(scheduler_t *s, const actor_id_t *actors, const int *workers, size_t n, int urgent) {
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        if (urgent) {
+            trace(TRACE_SCHEDULE, TRACE_INSTANT, actors[i], 1);
+            push_shared(s->urgent, &s->n_urgent, actors[i]);
+        } else
+            push_runnable(s, actors[i], workers[i]);
+    }
+
+    if (n > 0)
+        wake_for_batch(s, n);
+}
+
+void scheduler_busy(scheduler_t *s, int worker, long since) {
+    atomic_store_explicit(&s->idle[worker].busy_since, since, memory_order_relaxed);
+}
+
+/// whether a worker may take actors from the inbox of another one
+static inline int inbox_open(scheduler_t *s, int victim) {
+    long length = atomic_load_explicit(&s->inboxes[victim].length, memory_order_relaxed);
+    long since;
+
+    if (length > SCHEDULER_OVERLOAD || atomic_load_explicit(&s->idle[victim].parked, memory_order_relaxed))
+        return 1;
+
+    // a worker stuck in a long callback is as overloaded as one with a backlog
+    since = atomic_load_explicit(&s->idle[victim].busy_since, memory_order_relaxed);
+    return length > 0 && since != 0 && now_ns() - since > SCHEDULER_BUSY_NS;
+}
+
+/**
+ * Tries to take an actor from the workers on the same NUMA node as the calling one,
+ * or from those on the other nodes, starting at a random victim.
+ * @return  0 on success, -1 if every run queue looked empty
+ */
+static int steal_from(scheduler_t *s, int worker, int local, actor_id_t *actor) {
+    int i, res, victim, retry;
+    worker_inbox_t *inbox;
+
+    do {
+        retry  = 0;
+        victim = next_victim(s->n_workers);
+
+        for (i = 0; i < s->n_workers; ++i, victim = (victim + 1) % s->n_workers) {
+            if (victim == worker || (s->node[victim] == s->node[worker]) != local)
+                continue;
+
+            while ((res = deque_steal(s->deques[victim], actor)) == -2)
+                retry = 1;
+
+            if (res == 0)
+                return 0;
+
+            inbox = &s->inboxes[victim];
+            if (inbox_open(s, victim) && pop_shared(inbox->queue, &inbox->length, actor) == 0)
+                return 0;
+        }
+    } while (retry);
+
+    return -1;
+}
+
+/**
+ * Tries to take an actor from any other worker, those on other NUMA nodes come last.
+ * @return  0 on success, -1 if every run queue looked empty
+ */
+static int steal(scheduler_t *s, int worker, actor_id_t *actor) {
+    if (steal_from(s, worker, 1, actor) == 0)
+        return 0;
+
+    return s->n_nodes > 1 ? steal_from(s, worker, 0, actor) : -1;
+}
+
+/// checks whether any run queue the worker may take from is non empty
+static int work_available(scheduler_t *s, int worker) {
+    int i;
+
+    if (atomic_load(&s->n_injected) > 0 || atomic_load(&s->n_urgent) > 0)
+        return 1;
+
+    for (i = 0; i < s->n_workers; ++i) {
+        if (deque_size(s->deques[i]) > 0)
+            return 1;
+        if (atomic_load(&s->inboxes[i].length) > 0 && (i == worker || inbox_open(s, i)))
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Nothing wakes a worker when the inbox of a busy one opens, the sleep has to end by then.
+ * @return  time until the first inbox with actors in it opens, -1 if there is none
+ */
+static long until_inbox_opens(scheduler_t *s, int worker) {
+    int i;
+    long since, left, first = -1, now = 0;
+
+    for (i = 0; i < s->n_workers; ++i) {
+        if (i == worker || atomic_load(&s->inboxes[i].length) <= 0)
+            continue;
+
+        since = atomic_load_explicit(&s->idle[i].busy_since, memory_order_relaxed);
+        if (since == 0)
+            continue;
+
+        if (now == 0)
+            now = now_ns();
+        left = since + SCHEDULER_BUSY_NS - now;
+        left = left > 0 ? left : 0;
+        first = first < 0 || left < first ? left : first;
+    }
+
+    return first;
+}
+
+/**
+ * Looks for a runnable actor in all run queues, once.
+ * @return  0 on success, -1 if there was none
+ */
+static int find_work(scheduler_t *s, int worker, actor_id_t *actor) {
+    worker_inbox_t *inbox = &s->inboxes[worker];
+
+    if (pop_shared(s->urgent, &s->n_urgent, actor) == 0)
+        return 0;
+
+    // a busy worker would never look at its inbox and the injection queue otherwise
+    if (++ticks % SCHEDULER_INJECTED_INTERVAL == 0
+            && (pop_shared(inbox->queue, &inbox->length, actor) == 0
+                || pop_shared(s->injected, &s->n_injected, actor) == 0))
+        return 0;
+
+    // the own deque is taken from the top as well: an actor that keeps rescheduling
+    // itself must not starve the actors queued before it
+    if (deque_steal(s->deques[worker], actor) == 0)
+        return 0;
+
+    if (pop_shared(inbox->queue, &inbox->length, actor) == 0)
+        return 0;
+
+    if (pop_shared(s->injected, &s->n_injected, actor) == 0)
+        return 0;
+
+    return steal(s, worker, actor);
+}
+
+/**
+ * Polls the run queues for a while, so that work arriving shortly after the worker
+ * ran out of it does not have to wake it up. At most half of the workers spin at once,
+ * not counting those just woken up, which always look for the work they were woken for.
+ * @param woken     1 if the worker has been counted as spinning by park(), 0 o/w
+ * @return          0 if an actor was found, -1 o/w
+ */
+static int spin(scheduler_t *s, int worker, actor_id_t *actor, int woken) {
+    long i, budget;
+    int res = -1;
+    worker_idle_t *idle = &s->idle[worker];
+
+    if (!woken && atomic_fetch_add(&s->spinning, 1) >= (s->n_workers + 1) / 2) {
+        atomic_fetch_sub(&s->spinning, 1);
+        return -1;
+    }
+
+    budget = atomic_load_explicit(&idle->spin_budget, memory_order_relaxed);
+
+    for (i = 0; i < budget + SCHEDULER_YIELDS && res != 0
+                && !atomic_load_explicit(&s->interrupted, memory_order_relaxed); ++i) {
+        if (i < budget)
+            cpu_relax();
+        else
+            sched_yield();
+        res = find_work(s, worker, actor);
+    }
+
+    if (res == 0) {
+        atomic_fetch_add_explicit(&idle->spin_hits, 1, memory_order_relaxed);
+        budget = budget * 2 < SCHEDULER_SPIN_MAX ? budget * 2 : SCHEDULER_SPIN_MAX;
+    } else {
+        budget = budget / 2 > SCHEDULER_SPIN_MIN ? budget / 2 : SCHEDULER_SPIN_MIN;
+    }
+    atomic_store_explicit(&idle->spin_budget, budget, memory_order_relaxed);
+
+    // pushes skipped waking anybody while we spun; if the last spinner takes an actor
+    // and there are more, a sleeper has to take over. It spins in turn, so a burst
+    // wakes a chain of workers as long as there is work for them. A spinner that
+    // found nothing rechecks in park() instead.
+    if (atomic_fetch_sub(&s->spinning, 1) == 1 && res == 0) {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&s->sleeping, memory_order_relaxed) > 0 && work_available(s, worker))
+            wake(s, 1);
+    }
+
+    return res;
+}
+
+/**
+ * Puts the calling worker to sleep until some actor becomes runnable, or until the inbox
+ * of a busy worker that has actors in it opens. The worker comes back counted as spinning, so pushes leave waking others to it.
+ */
+static void park(scheduler_t *s, int worker) {
+    worker_idle_t *idle = &s->idle[worker];
+    unsigned int seq = atomic_load(&s->wake_seq); // a wakeup after this makes the wait return at once
+
+    atomic_fetch_add(&s->sleeping, 1);
+    atomic_store(&idle->parked, 1); // from now on others may take actors pushed to this worker
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (!work_available(s, worker) && !atomic_load(&s->interrupted)) {
+        atomic_fetch_add_explicit(&idle->parks, 1, memory_order_relaxed);
+        trace(TRACE_PARK, TRACE_BEGIN, -1, 0);
+        futex_wait(&s->wake_seq, seq, until_inbox_opens(s, worker));
+        trace(TRACE_PARK, TRACE_END, -1, 0);
+        atomic_fetch_add_explicit(&idle->wakeups, 1, memory_order_relaxed);
+    }
+
+    atomic_store(&idle->parked, 0);
+
+    atomic_fetch_add(&s->spinning, 1);
+    atomic_fetch_sub(&s->sleeping, 1);
+}
+
+int scheduler_pop(scheduler_t *s, int worker, actor_id_t *actor) {
+    int woken = 0;
+
+    while (!atomic_load_explicit(&s->interrupted, memory_order_acquire)) {
+        if (!woken && find_work(s, worker, actor) == 0)
+            return 0;
+
+        if (spin(s, worker, actor, woken) == 0)
+            return 0;
+
+        park(s, worker);
+        woken = 1;
+    }
+
+    if (woken)
+        atomic_fetch_sub(&s->spinning, 1);
+
+    return -1;
+}
+
+int scheduler_place(scheduler_t *s, int node) {
+    int i, first = (int) (atomic_fetch_add_explicit(&s->next_placed, 1, memory_order_relaxed) % s->n_workers);
+
+    node %= s->n_nodes;
+    for (i = 0; i < s->n_workers; ++i)
+        if (s->node[(first + i) % s->n_workers] == node)
+            return (first + i) % s->n_workers;
+
+    return first;
+}
+
+int scheduler_node(scheduler_t *s, int worker) {
+    return s->node[worker];
+}
+
+void scheduler_interrupt(scheduler_t *s) {
+    atomic_store(&s->interrupted, 1);
+    wake(s, INT_MAX);
+}
+
+void scheduler_idle_stats(scheduler_t *s, idle_stats_t *stats) {
+    int i;
+
+    stats->workers     = s->n_workers;
+    stats->spin_budget = stats->spin_hits = stats->parks = stats->wakeups = 0;
+
+    for (i = 0; i < s->n_workers; ++i) {
+        stats->spin_budget += atomic_load_explicit(&s->idle[i].spin_budget, memory_order_relaxed);
+        stats->spin_hits   += atomic_load_explicit(&s->idle[i].spin_hits, memory_order_relaxed);
+        stats->parks       += atomic_load_explicit(&s->idle[i].parks, memory_order_relaxed);
+        stats->wakeups     += atomic_load_explicit(&s->idle[i].wakeups, memory_order_relaxed);
+    }
+}
+
+long scheduler_length(scheduler_t *s) {
+    int i;
+    long length = atomic_load_explicit(&s->n_injected, memory_order_relaxed)
+                + atomic_load_explicit(&s->n_urgent, memory_order_relaxed);
+
+    for (i = 0; i < s->n_workers; ++i) {
+        length += deque_size(s->deques[i]);
+        length += atomic_load_explicit(&s->inboxes[i].length, memory_order_relaxed);
+    }
+
+    return length;
+}
+
+int scheduler_destroy(scheduler_t *s) {
+    int i;
+    actor_id_t ignored;
+
+    // an interrupted system may leave runnable actors behind
+    while (blocking_queue_try_pop(s->injected, &ignored) == 0);
+    blocking_queue_destroy(s->injected);
+    while (blocking_queue_try_pop(s->urgent, &ignored) == 0);
+    blocking_queue_destroy(s->urgent);
+
+    for (i = 0; i < s->n_workers; ++i) {
+        deque_destroy(s->deques[i]);
+        while (blocking_queue_try_pop(s->inboxes[i].queue, &ignored) == 0);
+        blocking_queue_destroy(s->inboxes[i].queue);
+    }
+    free(s->deques);
+    free(s->inboxes);
+    free(s->node);
+    free(s->idle);
+
+    free(s);
+    return 0;
+}
@@ -0,0 +1,140 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "cacti.h"
+#include "deque.h"
+#include "blocking_queue.h"
+
+#define SCHEDULER_INJECTED_INTERVAL 61  ///< a worker checks the injection queue first every this many pops
+#define SCHEDULER_SPIN_MIN 16           ///< polls of the run queues an idle worker makes at least before it parks
+#define SCHEDULER_SPIN_MAX 1024         ///< polls of the run queues an idle worker makes at most before it parks
+#define SCHEDULER_YIELDS 4              ///< polls after the spin, each one preceded by sched_yield
+#define SCHEDULER_OVERLOAD 4            ///< actors waiting in the inbox of a busy worker before others take them
+#define SCHEDULER_BUSY_NS 1000000L      ///< time a worker may spend on one activation before others take from its inbox
+
+/**
+ * Idle state of a single worker. The spin budget doubles when spinning finds work
+ * and halves when the worker has to park anyway.
+ */
+typedef struct worker_idle {
+    _Alignas(CACHE_LINE) atomic_long spin_budget;   ///< polls before parking
+    atomic_long spin_hits;                          ///< times spinning found work
+    atomic_long parks;                              ///< times the worker went to sleep
+    atomic_long wakeups;                            ///< times the worker was woken up
+    atomic_int parked;                              ///< 1 while the worker sleeps, 0 o/w
+    atomic_long busy_since;                         ///< start of the activation the worker runs, 0 between them
+} worker_idle_t;
+
+/**
+ * Actors that should run on a worker, pushed by other threads. Other workers take
+ * them only if the owner sleeps, has more than SCHEDULER_OVERLOAD of them or has
+ * been busy with one activation for longer than SCHEDULER_BUSY_NS.
+ */
+typedef struct worker_inbox {
+    _Alignas(CACHE_LINE) blocking_queue_t *queue;
+    atomic_long length;             ///< length of the queue, read without its lock
+} worker_inbox_t;
+
+/**
+ * Run queues of the thread pool. Every worker owns a work-stealing deque,
+ * actors made runnable by a worker are pushed onto its own deque and idle
+ * workers steal from random victims, from those on their own NUMA node first.
+ * An actor that last ran on another worker goes to that worker's inbox, so it
+ * keeps its caches warm. Other actors made runnable outside the pool go through
+ * the shared injection queue.
+ *
+ * A worker that runs out of work spins for a while, polling the run queues,
+ * and then parks on a futex. A push wakes a parked worker only if no worker
+ * is spinning; a spinner that finds work wakes one if there is more of it.
+ */
+typedef struct scheduler {
+    int n_workers;                  ///< number of workers (and deques)
+    int n_nodes;                    ///< number of NUMA nodes the workers run on
+    int *node;                      ///< NUMA node of each worker
+    atomic_uint next_placed;        ///< round robin counter of scheduler_place
+    deque_t **deques;               ///< run queue of each worker
+    worker_inbox_t *inboxes;        ///< actors pushed to each worker by other threads
+    blocking_queue_t *injected;     ///< actors scheduled by threads outside of the pool
+    atomic_long n_injected;         ///< length of the injection queue, read without its lock
+    blocking_queue_t *urgent;       ///< actors with urgent messages, taken before all others
+    atomic_long n_urgent;           ///< length of the urgent queue, read without its lock
+    worker_idle_t *idle;            ///< idle state of each worker
+
+    _Alignas(CACHE_LINE) atomic_uint wake_seq;  ///< futex parked workers wait on, bumped by every wakeup
+    atomic_int sleeping;            ///< number of parked workers
+    atomic_int spinning;            ///< number of spinning workers
+    atomic_int interrupted;         ///< 1 if workers should stop, 0 o/w
+} scheduler_t;
+
+/**
+ * @param node      NUMA node of each worker, NULL if all of them run on one node
+ */
+extern scheduler_t* scheduler_init(int n_workers, const int *node);
+
+/**
+ * Binds the calling thread to the worker with the given number,
+ * later pushes made by this thread go to that worker's deque.
+ */
+extern void scheduler_attach(scheduler_t *s, int worker);
+
+/**
+ * Makes an actor runnable. Wakes a parked worker if there is one and nobody spins.
+ * @param worker    the worker the actor should run on, -1 for the calling worker
+ *                  or, outside of the pool, for any
+ */
+extern void scheduler_push(scheduler_t *s, actor_id_t actor, int worker);
+
+/**
+ * Makes an actor runnable ahead of the actors made runnable by scheduler_push.
+ */
+extern void scheduler_push_urgent(scheduler_t *s, actor_id_t actor);
+
+/**
+ * A blocking function that returns the next runnable actor for the calling worker.
+ * Looks at the urgent queue, the worker's own deque and inbox, then the injection queue, then tries to steal,
+ * spins doing so for a while when there is nothing to steal and only then parks.
+ * @param[out] actor    - the actor that shall be processed,
+ * @return              - 0 on success, -1 if the scheduler has been interrupted
+ */
+extern int scheduler_pop(scheduler_t *s, int worker, actor_id_t *actor);
+
+/**
+ * Tells since when a worker has been running an activation, in nanoseconds of CLOCK_MONOTONIC,
+ * 0 once it has finished. May be called only by the worker.
+ */
+extern void scheduler_busy(scheduler_t *s, int worker, long since);
+
+/**
+ * Makes a batch of actors runnable, as scheduler_push or scheduler_push_urgent would one by one,
+ * and wakes up as many parked workers as there are actors the spinning ones will not take.
+ * @param workers   the worker each actor should run on, ignored if urgent
+ */
+extern void scheduler_push_many(scheduler_t *s, const actor_id_t *actors, const int *workers, size_t n, int urgent);
+
+/**
+ * Picks a worker on a NUMA node, the workers of a node take turns.
+ * @param node      the node modulo the number of nodes
+ */
+extern int scheduler_place(scheduler_t *s, int node);
+
+/// NUMA node of a worker
+extern int scheduler_node(scheduler_t *s, int worker);
+
+/**
+ * Wakes up all workers and makes scheduler_pop return -1 from now on.
+ */
+extern void scheduler_interrupt(scheduler_t *s);
+
+/// sums up the idle states of all workers
+extern void scheduler_idle_stats(scheduler_t *s, idle_stats_t *stats);
+
+/// actors waiting in the run queues, counted queue by queue while they change
+extern long scheduler_length(scheduler_t *s);
+
+/// should be called only after all workers have returned
+extern int scheduler_destroy(scheduler_t *s);
+
+#endif //SCHEDULER_H
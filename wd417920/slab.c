@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "slab.h"
+#include "err.h"
+
+#ifdef SLAB_USE_MALLOC
+
+void* slab_alloc(size_t size) {
+    return safe_aligned_malloc(size);
+}
+
+void slab_free(void *ptr) {
+    free(ptr);
+}
+
+#else
+
+#define SLAB_LARGE SLAB_CLASSES     ///< class of a block that has a slab of its own
+#define SLAB_HEADER CACHE_LINE      ///< space taken by slab_header_t, keeps blocks aligned
+
+typedef struct slab_block {
+    struct slab_block *next;
+} slab_block_t;
+
+typedef struct slab_heap {
+    slab_block_t *local[SLAB_CLASSES];                                  ///< free blocks, owner only
+    _Alignas(CACHE_LINE) slab_block_t* _Atomic remote[SLAB_CLASSES];    ///< blocks freed by other threads
+    struct slab_heap *next_abandoned;                                   ///< next heap without an owner
+} slab_heap_t;
+
+/// the beginning of every slab, its blocks follow
+typedef struct slab_header {
+    slab_heap_t *heap;      ///< heap the blocks belong to, NULL for a large block
+    int size_class;
+} slab_header_t;
+
+static __thread slab_heap_t *own_heap = NULL;   ///< heap of the calling thread
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t heap_key;                  ///< hands the heap over when its thread exits
+static pthread_mutex_t abandoned_lock = PTHREAD_MUTEX_INITIALIZER;
+static slab_heap_t *abandoned = NULL;           ///< heaps of threads that have exited
+
+static void abandon_heap(void *heap) {
+    own_heap = NULL; // later frees of this thread are remote
+
+    safe_lock(&abandoned_lock);
+    ((slab_heap_t*) heap)->next_abandoned = abandoned;
+    abandoned = heap;
+    safe_unlock(&abandoned_lock);
+}
+
+static void create_key() {
+    int err;
+    if ((err = pthread_key_create(&heap_key, abandon_heap)) != 0)
+        syserr(err, "key create failed");
+}
+
+/// heap of the calling thread, created or taken over on its first allocation
+static slab_heap_t* get_heap() {
+    int err;
+
+    if (own_heap != NULL)
+        return own_heap;
+
+    if ((err = pthread_once(&key_once, create_key)) != 0)
+        syserr(err, "once failed");
+
+    safe_lock(&abandoned_lock);
+    if (abandoned != NULL) {
+        own_heap  = abandoned;
+        abandoned = abandoned->next_abandoned;
+    }
+    safe_unlock(&abandoned_lock);
+
+    if (own_heap == NULL) {
+        own_heap = safe_aligned_malloc(sizeof(slab_heap_t));
+        memset(own_heap, 0, sizeof(slab_heap_t));
+    }
+
+    if ((err = pthread_setspecific(heap_key, own_heap)) != 0)
+        syserr(err, "setspecific failed");
+
+    return own_heap;
+}
+
+static inline int class_of(size_t size) {
+    if (size <= (1 << SLAB_MIN_SHIFT))
+        return 0;
+    return 64 - __builtin_clzl(size - 1) - SLAB_MIN_SHIFT;
+}
+
+static inline slab_header_t* header_of(void *ptr) {
+    return (slab_header_t*) ((uintptr_t) ptr & ~(uintptr_t) (SLAB_SIZE - 1));
+}
+
+static void* new_slab(size_t size) {
+    void *slab = NULL;
+    int err;
+
+    if ((err = posix_memalign(&slab, SLAB_SIZE, size)) != 0)
+        syserr(err, "Out of memory (%zu bytes)", size);
+
+    return slab;
+}
+
+/**
+ * Finds free blocks of a class when the local list is empty: takes those freed by
+ * other threads, or cuts a new slab into blocks.
+ * @return      a list of free blocks
+ */
+static slab_block_t* refill(slab_heap_t *heap, int size_class) {
+    size_t i, size = (size_t) 1 << (size_class + SLAB_MIN_SHIFT);
+    slab_block_t *block = atomic_exchange_explicit(&heap->remote[size_class], NULL, memory_order_acquire);
+
+    if (block != NULL)
+        return block;
+
+    char *slab = new_slab(SLAB_SIZE);
+    size_t n = (SLAB_SIZE - SLAB_HEADER) / size;
+
+    ((slab_header_t*) slab)->heap       = heap;
+    ((slab_header_t*) slab)->size_class = size_class;
+
+    for (i = 0; i < n; ++i) {
+        block = (slab_block_t*) (slab + SLAB_HEADER + i * size);
+        block->next = i + 1 < n ? (slab_block_t*) (slab + SLAB_HEADER + (i + 1) * size) : NULL;
+    }
+
+    return (slab_block_t*) (slab + SLAB_HEADER);
+}
+
+void* slab_alloc(size_t size) {
+    int size_class = class_of(size);
+    slab_block_t *block;
+
+    if (size_class >= SLAB_CLASSES) {
+        slab_header_t *slab = new_slab(SLAB_HEADER + size);
+        slab->heap       = NULL;
+        slab->size_class = SLAB_LARGE;
+        return (char*) slab + SLAB_HEADER;
+    }
+
+    slab_heap_t *heap = get_heap();
+
+    if ((block = heap->local[size_class]) == NULL)
+        block = refill(heap, size_class);
+
+    heap->local[size_class] = block->next;
+    return block;
+}
+
+void slab_free(void *ptr) {
+    slab_block_t *block = ptr;
+
+    if (ptr == NULL)
+        return;
+
+    slab_header_t *slab = header_of(ptr);
+    slab_heap_t *heap = slab->heap;
+
+    if (heap == NULL) {
+        free(slab);
+        return;
+    }
+
+    if (heap == own_heap) {
+        block->next = heap->local[slab->size_class];
+        heap->local[slab->size_class] = block;
+        return;
+    }
+
+    // the owner takes the whole list at once, so pushes alone cannot suffer from ABA
+    slab_block_t *head = atomic_load_explicit(&heap->remote[slab->size_class], memory_order_relaxed);
+    do {
+        block->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&heap->remote[slab->size_class], &head, block,
+            memory_order_release, memory_order_relaxed));
+}
+
+#endif
@@ -0,0 +1,32 @@
+// Slab allocator for small blocks that are often freed by another thread than
+// the one that allocated them, like messages and their payloads.
+//
+// Every thread takes blocks from a heap of its own, without synchronisation.
+// A block freed by another thread is pushed onto a lock-free list of the heap
+// it came from, which the owner takes over as a whole once its local list of
+// that size runs dry. Heaps of threads that have exited are handed over to new
+// threads, so blocks are never returned to the system.
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+#define SLAB_SIZE (64 * 1024)   ///< bytes of a slab, slabs are aligned to their size
+#define SLAB_MIN_SHIFT 4        ///< the smallest class holds 16 bytes
+#define SLAB_CLASSES 8          ///< blocks of 16, 32, ..., 2048 bytes, bigger ones get a slab of their own
+
+/**
+ * Allocates a block of at least size bytes. Blocks of CACHE_LINE bytes or more
+ * are aligned to a cache line. Ends the program if there is no memory.
+ * Compiled with SLAB_USE_MALLOC it only forwards to malloc, for memory checkers.
+ */
+extern void* slab_alloc(size_t size);
+
+/**
+ * Frees a block allocated by slab_alloc. May be called by any thread.
+ * @param ptr   - the block, nothing happens if NULL
+ */
+extern void slab_free(void *ptr);
+
+#endif //SLAB_H
@@ -0,0 +1,61 @@
+// Runtime counters of a system, kept in a cache line per worker.
+//
+// A worker adds to its own slot with plain relaxed loads and stores, threads outside
+// of the pools share one more slot and add to it atomically. Readers sum the slots
+// without stopping anybody, so a snapshot may be a few increments behind. With
+// CACTI_STATS set to 0 the helpers are empty and callers compile to nothing.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+
+#include "cacti.h"
+#include "err.h"
+
+#define STATS_SENT          0   ///< messages accepted into mailboxes
+#define STATS_REJECTED      1   ///< sends that found a mailbox full
+#define STATS_PROCESSED     2   ///< messages taken by the worker
+#define STATS_ACTIVATIONS   3   ///< actors taken by the worker
+#define STATS_BUSY_NS       4   ///< time spent from taking an actor until releasing it
+#define STATS_IDLE_NS       5   ///< time spent looking for an actor, parked included
+#define STATS_HIGH_WATER    6   ///< most messages an actor had pending when the worker took it
+#define STATS_COUNTERS      7
+
+typedef struct stats_slot {
+    _Alignas(CACHE_LINE) atomic_long counters[STATS_COUNTERS];
+    long idle_since;            ///< end of the last activation, owner only
+    long active_since;          ///< start of the running activation, owner only
+} stats_slot_t;
+
+/**
+ * @param owned     1 if the calling thread is the only one that writes to the slot
+ */
+static inline void stats_add(stats_slot_t *slot, int counter, long n, int owned) {
+#if CACTI_STATS
+    if (owned)
+        atomic_store_explicit(&slot->counters[counter],
+                              atomic_load_explicit(&slot->counters[counter], memory_order_relaxed) + n,
+                              memory_order_relaxed);
+    else
+        atomic_fetch_add_explicit(&slot->counters[counter], n, memory_order_relaxed);
+#else
+    (void) slot, (void) counter, (void) n, (void) owned;
+#endif
+}
+
+/// raises a counter of the calling thread's own slot to n
+static inline void stats_max(stats_slot_t *slot, int counter, long n) {
+#if CACTI_STATS
+    if (n > atomic_load_explicit(&slot->counters[counter], memory_order_relaxed))
+        atomic_store_explicit(&slot->counters[counter], n, memory_order_relaxed);
+#else
+    (void) slot, (void) counter, (void) n;
+#endif
+}
+
+static inline long stats_get(stats_slot_t *slot, int counter) {
+    return atomic_load_explicit(&slot->counters[counter], memory_order_relaxed);
+}
+
+#endif //STATS_H
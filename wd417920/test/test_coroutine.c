@@ -0,0 +1,199 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_OTHER 1
+#define MSG_ANSWER 2
+#define MSG_ASK 1
+
+#define ASKERS 1000         ///< more than COROUTINE_POOL_MAX, most of them wait at once
+#define OTHERS 3            ///< messages an asker gets before its answer
+#define ANSWER 42L
+
+int tests_run = 0;
+
+typedef struct asker {
+    int answered;           ///< 1 once the answer has come
+    int others;             ///< other messages processed so far
+    int in_order;           ///< 1 while the other messages come in order, after the answer
+} asker_t;
+
+static role_t asker_role, answerer_role, closing_role;
+static asker_t askers[ASKERS];
+static actor_id_t answerer;
+static atomic_int done;             ///< askers that got all their messages
+static atomic_int answer_prompts;   ///< times the prompt of MSG_ANSWER was called
+static int outside_await;
+static int closed_await[2];
+
+static void die() {
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+// sends a few other messages and only then the answer
+static void answerer_ask(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    actor_id_t asker = *(actor_id_t*) data;
+    int i;
+
+    for (i = 1; i <= OTHERS; ++i)
+        send_message_inline(asker, MSG_OTHER, &i, sizeof(int));
+
+    send_message(asker, (message_t) { .message_type = MSG_ANSWER, .data = (void*) ANSWER });
+}
+
+static void nothing(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+}
+
+// asks and waits for the answer in the middle of the callback
+static void asker_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    asker_t *asker = *stateptr;
+    actor_id_t self = actor_id_self();
+    message_t answer;
+
+    send_message_inline(answerer, MSG_ASK, &self, sizeof(actor_id_t));
+
+    if (actor_await(MSG_ANSWER, &answer) == 0 && answer.data == (void*) ANSWER && actor_id_self() == self)
+        asker->answered = 1;
+}
+
+static void asker_other(void **stateptr, size_t nbytes, void *data) {
+    asker_t *asker = *stateptr;
+
+    if (!asker->answered || nbytes != sizeof(int) || *(int*) data != ++asker->others)
+        asker->in_order = 0;
+
+    if (asker->others == OTHERS) {
+        if (atomic_fetch_add(&done, 1) == ASKERS - 1)
+            send_message(answerer, (message_t) { .message_type = MSG_GODIE });
+        die();
+    }
+}
+
+static void asker_answer(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    atomic_fetch_add(&answer_prompts, 1);
+}
+
+static void spawner_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    actor_id_t ids[ASKERS];
+    void *states[ASKERS];
+    int i;
+
+    for (i = 0; i < ASKERS; ++i) {
+        askers[i] = (asker_t) { .in_order = 1 };
+        states[i] = &askers[i];
+    }
+
+    answerer = actor_spawn(&answerer_role, NULL);
+    actor_spawn_many(&asker_role, ASKERS, states, ids);
+    die();
+}
+
+// callbacks wait for replies, other messages wait for the callbacks
+static char *await_reply()
+{
+    int i;
+    actor_id_t spawner;
+    act_t spawner_prompts[] = { spawner_hello };
+    act_t answerer_prompts[] = { nothing, answerer_ask };
+    act_t asker_prompts[] = { asker_hello, asker_other, asker_answer };
+    role_t spawner_role = { .nprompts = 1, .prompts = spawner_prompts };
+    answerer_role = (role_t) { .nprompts = 2, .prompts = answerer_prompts };
+    asker_role    = (role_t) { .nprompts = 3, .prompts = asker_prompts, .coroutine = 1 };
+
+    atomic_store(&done, 0);
+    atomic_store(&answer_prompts, 0);
+
+    mu_assert("create failed", actor_system_create(&spawner, &spawner_role) == 0);
+    actor_system_join(spawner);
+
+    mu_assert("not all askers are done", atomic_load(&done) == ASKERS);
+    mu_assert("an awaited message went to its prompt", atomic_load(&answer_prompts) == 0);
+    for (i = 0; i < ASKERS; ++i) {
+        mu_assert("an answer is missing", askers[i].answered);
+        mu_assert("other messages came out of order", askers[i].in_order);
+    }
+    return 0;
+}
+
+// MSG_GODIE wakes up a callback waiting for a message that will never come
+static void closing_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    message_t never;
+
+    die();
+    closed_await[0] = actor_await(MSG_ANSWER, &never);
+    closed_await[1] = actor_await(MSG_ANSWER, &never);
+}
+
+static void plain_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    message_t never;
+
+    outside_await = actor_await(MSG_ANSWER, &never);
+    actor_spawn(&closing_role, NULL);
+    die();
+}
+
+static char *await_until_death()
+{
+    actor_id_t first;
+    act_t plain_prompts[] = { plain_hello };
+    act_t closing_prompts[] = { closing_hello, nothing, nothing };
+    role_t plain_role = { .nprompts = 1, .prompts = plain_prompts };
+    closing_role = (role_t) { .nprompts = 3, .prompts = closing_prompts, .coroutine = 1 };
+
+    closed_await[0] = closed_await[1] = 0;
+
+    mu_assert("create failed", actor_system_create(&first, &plain_role) == 0);
+    actor_system_join(first);
+
+    mu_assert("awaited outside of a coroutine", outside_await == -1);
+    mu_assert("MSG_GODIE did not end the wait", closed_await[0] == -1);
+    mu_assert("waited after MSG_GODIE", closed_await[1] == -1);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(await_reply);
+    mu_run_test(await_until_death);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
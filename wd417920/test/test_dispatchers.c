@@ -0,0 +1,191 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_PING 1
+#define BLOCKERS 3
+#define ROUNDS 1000
+#define BLOCK_DEADLINE_NS 5000000000L   ///< how long blockers wait to be released
+
+int tests_run = 0;
+
+static role_t blocker_role, ponger_role, plain_role;
+static atomic_int released;         ///< 1 once the ping-pong is over
+static atomic_int in_time;          ///< blockers released before their deadline
+static atomic_int n_blocked;
+static pthread_t blocked_on[BLOCKERS];
+static pthread_t pinged_on;
+static actor_id_t ponger;
+static int rounds;
+static actor_id_t missing, elsewhere;
+static pthread_t elsewhere_on;
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void die() {
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+// holds its worker until the ping-pong is over
+static void blocker_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    struct timespec pause = { .tv_nsec = 100000 };
+    long deadline = now_ns() + BLOCK_DEADLINE_NS;
+
+    blocked_on[atomic_fetch_add(&n_blocked, 1)] = pthread_self();
+
+    while (!atomic_load(&released) && now_ns() < deadline)
+        nanosleep(&pause, NULL);
+
+    if (atomic_load(&released))
+        atomic_fetch_add(&in_time, 1);
+
+    die();
+}
+
+static void ponger_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+}
+
+static void pong(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+
+    send_message((actor_id_t) data, (message_t) { .message_type = MSG_PING });
+}
+
+static void pinger_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    actor_id_t blockers[BLOCKERS];
+
+    rounds    = 0;
+    pinged_on = pthread_self();
+    actor_spawn_many(&blocker_role, BLOCKERS, NULL, blockers);
+    ponger = actor_spawn(&ponger_role, NULL);
+
+    send_message(ponger, (message_t) { .message_type = MSG_PING, .data = (void*) actor_id_self() });
+}
+
+static void ping(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    if (++rounds < ROUNDS) {
+        send_message(ponger, (message_t) { .message_type = MSG_PING, .data = (void*) actor_id_self() });
+        return;
+    }
+
+    atomic_store(&released, 1);
+    send_message(ponger, (message_t) { .message_type = MSG_GODIE });
+    die();
+}
+
+// actors that block run on a dispatcher of their own and do not hold up the others
+static char *blocking_dispatcher()
+{
+    int i;
+    actor_id_t pinger;
+    act_t pinger_prompts[] = { pinger_hello, ping };
+    act_t ponger_prompts[] = { ponger_hello, pong };
+    act_t blocker_prompts[] = { blocker_hello };
+    dispatcher_config_t dispatchers[] = { { .name = "blocking", .n_workers = 1 } };
+    actor_system_config_t config = { .n_workers = 2, .dispatchers = dispatchers, .n_dispatchers = 1 };
+    role_t pinger_role = { .nprompts = 2, .prompts = pinger_prompts };
+    ponger_role  = (role_t) { .nprompts = 2, .prompts = ponger_prompts };
+    blocker_role = (role_t) { .nprompts = 1, .prompts = blocker_prompts, .dispatcher = "blocking" };
+
+    atomic_store(&released, 0);
+    atomic_store(&in_time, 0);
+    atomic_store(&n_blocked, 0);
+
+    mu_assert("create failed", actor_system_create_ex(&pinger, &pinger_role, &config) == 0);
+    actor_system_join(pinger);
+
+    mu_assert("ping-pong waited for blockers", atomic_load(&in_time) == BLOCKERS);
+    mu_assert("ping-pong did not finish", rounds == ROUNDS);
+    for (i = 0; i < BLOCKERS; ++i) {
+        mu_assert("blockers ran on several threads", pthread_equal(blocked_on[i], blocked_on[0]));
+        mu_assert("a blocker ran on the default dispatcher", !pthread_equal(blocked_on[i], pinged_on));
+    }
+    return 0;
+}
+
+static void plain_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    // the spawned one starts with a state
+    if (*stateptr != NULL) {
+        elsewhere_on = pthread_self();
+        die();
+        return;
+    }
+
+    missing   = actor_spawn_on("missing", &plain_role, &missing);
+    elsewhere = actor_spawn_on("other", &plain_role, &elsewhere);
+    pinged_on = pthread_self();
+    die();
+}
+
+// a spawn may put an actor on another dispatcher than its role's
+static char *spawn_on_dispatcher()
+{
+    actor_id_t first;
+    act_t prompts[] = { plain_hello };
+    dispatcher_config_t dispatchers[] = { { .name = "other", .n_workers = 1 } };
+    dispatcher_config_t twice[] = { { .name = "other", .n_workers = 1 }, { .name = "other", .n_workers = 1 } };
+    actor_system_config_t config = { .n_workers = 1, .dispatchers = twice, .n_dispatchers = 2 };
+    plain_role = (role_t) { .nprompts = 1, .prompts = prompts };
+
+    mu_assert("dispatchers with the same name", cacti_system_create(&first, &plain_role, &config) == NULL);
+
+    config.dispatchers   = dispatchers;
+    config.n_dispatchers = 1;
+    mu_assert("create failed", actor_system_create_ex(&first, &plain_role, &config) == 0);
+    actor_system_join(first);
+
+    mu_assert("spawned on a missing dispatcher", missing == -1);
+    mu_assert("spawn failed", elsewhere >= 0);
+    mu_assert("spawned on the spawner's dispatcher", !pthread_equal(elsewhere_on, pinged_on));
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(blocking_dispatcher);
+    mu_run_test(spawn_on_dispatcher);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
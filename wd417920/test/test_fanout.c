@@ -0,0 +1,96 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define FANOUT_DEADLINE_NS 5000000000L  ///< how long children wait for each other
+
+int tests_run = 0;
+
+static role_t child_role;
+static atomic_int inside;   ///< children in their HELLO callback
+static atomic_int met;      ///< children that saw POOL_SIZE children inside at once
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// spawns POOL_SIZE children at once, the worker running it wakes up the others
+static void parent_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    int i;
+
+    for (i = 0; i < POOL_SIZE; ++i)
+        send_message(actor_id_self(), (message_t) { .message_type = MSG_SPAWN, .data = &child_role });
+
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+// blocks its worker until all children are inside, which takes all POOL_SIZE workers
+static void child_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    struct timespec pause = { .tv_nsec = 100000 };
+    long deadline = now_ns() + FANOUT_DEADLINE_NS;
+
+    atomic_fetch_add(&inside, 1);
+
+    while (atomic_load(&inside) < POOL_SIZE && now_ns() < deadline)
+        nanosleep(&pause, NULL);
+
+    if (atomic_load(&inside) == POOL_SIZE)
+        atomic_fetch_add(&met, 1);
+
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static char *all_workers_busy()
+{
+    actor_id_t parent;
+    act_t parent_prompts[] = { parent_hello };
+    act_t child_prompts[] = { child_hello };
+    role_t parent_role = { .nprompts = 1, .prompts = parent_prompts };
+    child_role = (role_t) { .nprompts = 1, .prompts = child_prompts };
+
+    atomic_store(&inside, 0);
+    atomic_store(&met, 0);
+
+    mu_assert("create failed", actor_system_create(&parent, &parent_role) == 0);
+    actor_system_join(parent);
+
+    mu_assert("not all workers were busy", atomic_load(&met) == POOL_SIZE);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(all_workers_busy);
+    mu_run_test(all_workers_busy);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
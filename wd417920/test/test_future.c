@@ -0,0 +1,176 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_SQUARE 1
+#define MSG_SILENT 2
+#define MSG_LATE 3
+#define MSG_REPLY 1
+
+#define ASKS 1000           ///< asks made one after another, they reuse the same slots
+#define TIMEOUT_NS 1000000L
+
+int tests_run = 0;
+
+typedef struct server {
+    future_t silent;        ///< ask of MSG_SILENT, replied to only on MSG_LATE
+    int late_reply;         ///< what that reply returned
+} server_t;
+
+static role_t server_role;
+static server_t server;
+static long replied;        ///< sum of the replies the asker got
+static int replies;         ///< number of those replies
+static long own_request;    ///< actor_request in a callback of a message that is not an ask
+static int then_failed;
+
+static void die() {
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static void server_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    *stateptr = &server;
+}
+
+static void server_square(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    long n = (long) data;
+
+    actor_reply(actor_request(), (void*) (n * n));
+}
+
+static void server_silent(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    ((server_t*) *stateptr)->silent = actor_request();
+}
+
+static void server_late(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    server_t *s = *stateptr;
+
+    s->late_reply = actor_reply(s->silent, NULL);
+    die();
+}
+
+// a thread outside of the system waits for replies, and gives one up
+static char *wait_outside()
+{
+    long i;
+    void *reply;
+    actor_id_t actor;
+    future_t future;
+    actor_system_config_t config = { .n_workers = 2 };
+    act_t server_prompts[] = { server_hello, server_square, server_silent, server_late };
+    server_role = (role_t) { .nprompts = 4, .prompts = server_prompts };
+
+    server = (server_t) { .late_reply = 0 };
+
+    cacti_system_t *system = cacti_system_create(&actor, &server_role, &config);
+    mu_assert("create failed", system != NULL);
+
+    for (i = 0; i < ASKS; ++i) {
+        future = cacti_ask(system, actor, (message_t) { .message_type = MSG_SQUARE, .data = (void*) i });
+        mu_assert("ask failed", future.id >= 0);
+        mu_assert("wait failed", future_wait(future, -1, &reply) == 0);
+        mu_assert("wrong reply", (long) reply == i * i);
+        mu_assert("waited twice", future_wait(future, 0, &reply) == -2);
+    }
+
+    future = cacti_ask(system, actor, (message_t) { .message_type = MSG_SILENT });
+    mu_assert("ask failed", future.id >= 0);
+    mu_assert("no timeout", future_wait(future, TIMEOUT_NS, &reply) == -1);
+    mu_assert("cancel failed", future_cancel(future) == 0);
+    mu_assert("waited after cancel", future_wait(future, 0, &reply) == -2);
+    mu_assert("asked to die", cacti_ask(system, actor, (message_t) { .message_type = MSG_GODIE }).id == -2);
+
+    cacti_send(system, actor, (message_t) { .message_type = MSG_LATE });
+    cacti_system_join(system);
+
+    mu_assert("replied after cancel", server.late_reply == -1);
+    return 0;
+}
+
+// asks from an actor, the replies come back as messages
+static void asker_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    actor_id_t s = actor_spawn(&server_role, NULL);
+    long i;
+
+    own_request = actor_request().id;
+
+    for (i = 0; i < ASKS; ++i) {
+        future_t future = actor_ask(s, (message_t) { .message_type = MSG_SQUARE, .data = (void*) i });
+        if (future_then(future, MSG_REPLY) != 0)
+            then_failed = 1;
+    }
+
+    *stateptr = (void*) s;
+}
+
+static void asker_reply(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+
+    replied += (long) data;
+    if (++replies == ASKS) {
+        send_message((actor_id_t) *stateptr, (message_t) { .message_type = MSG_GODIE });
+        die();
+    }
+}
+
+static char *continue_in_actor()
+{
+    long i, expected = 0;
+    actor_id_t asker;
+    act_t asker_prompts[] = { asker_hello, asker_reply };
+    act_t server_prompts[] = { server_hello, server_square };
+    role_t asker_role = { .nprompts = 2, .prompts = asker_prompts };
+    server_role = (role_t) { .nprompts = 2, .prompts = server_prompts };
+
+    replied = replies = then_failed = 0;
+    own_request = 0;
+
+    mu_assert("create failed", actor_system_create(&asker, &asker_role) == 0);
+    actor_system_join(asker);
+
+    for (i = 0; i < ASKS; ++i)
+        expected += i * i;
+
+    mu_assert("a request outside of an ask", own_request == -1);
+    mu_assert("then failed", !then_failed);
+    mu_assert("replies are missing", replies == ASKS && replied == expected);
+    mu_assert("then outside of actors", future_then((future_t) { .system = NULL, .id = 0 }, MSG_REPLY) == -2);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(wait_outside);
+    mu_run_test(continue_in_actor);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
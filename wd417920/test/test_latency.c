@@ -0,0 +1,144 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_PING 1
+#define MSG_SLOW 2
+
+#define PINGS 100
+#define SLOW_NS 2000000L
+
+int tests_run = 0;
+
+static role_t child_role;
+
+static void die() {
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static void nothing(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+}
+
+static void slow(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = SLOW_NS };
+    nanosleep(&ts, NULL);
+}
+
+static void parent_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    actor_id_t child = actor_spawn(&child_role, NULL);
+    int i;
+
+    // the pings wait in the mailbox while the slow callback runs
+    send_message(child, (message_t) { .message_type = MSG_SLOW });
+    for (i = 0; i < PINGS; ++i)
+        send_message(child, (message_t) { .message_type = MSG_PING });
+
+    send_message(child, (message_t) { .message_type = MSG_GODIE });
+    die();
+}
+
+static act_t parent_prompts[] = { parent_hello };
+static act_t child_prompts[] = { nothing, nothing, slow };
+static role_t parent_role = { .nprompts = 1, .prompts = parent_prompts };
+
+static const latency_stats_t *find(const latency_stats_t *stats, size_t n, const role_t *role, message_type_t type) {
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        if (stats[i].role == role && stats[i].message_type == type)
+            return &stats[i];
+    }
+
+    return NULL;
+}
+
+static int ordered(latency_percentiles_t p) {
+    return p.p50 <= p.p99 && p.p99 <= p.p999 && p.p999 <= p.max;
+}
+
+// every pair of a role and a message type gets histograms of its own
+static char *per_role_and_type()
+{
+    actor_id_t parent;
+    latency_stats_t stats[16];
+    const latency_stats_t *ping, *slowest, *hello;
+    size_t n;
+
+    child_role = (role_t) { .nprompts = 3, .prompts = child_prompts };
+    actor_system_create(&parent, &parent_role);
+    actor_system_join(parent);
+
+    n = cacti_latency_snapshot(NULL, stats, 16);
+    mu_assert("too many pairs", n <= 16);
+
+    ping    = find(stats, n, &child_role, MSG_PING);
+    slowest = find(stats, n, &child_role, MSG_SLOW);
+    hello   = find(stats, n, &parent_role, MSG_HELLO);
+    mu_assert("pairs are missing", ping != NULL && slowest != NULL && hello != NULL);
+
+    mu_assert("wrong number of pings", ping->queued.count == PINGS && ping->run.count == PINGS);
+    mu_assert("wrong number of slow messages", slowest->run.count == 1 && hello->run.count == 1);
+    mu_assert("slow callback too fast", slowest->run.p50 >= SLOW_NS * 7 / 8);
+    mu_assert("pings did not wait for the slow callback", ping->queued.max >= SLOW_NS * 7 / 8);
+    mu_assert("percentiles out of order",
+              ordered(ping->queued) && ordered(ping->run) && ordered(slowest->run) && ordered(hello->queued));
+
+    return 0;
+}
+
+// a system of its own keeps its histograms apart from the default one
+static char *own_system()
+{
+    actor_id_t parent;
+    actor_system_config_t config = { .n_workers = 2 };
+    latency_stats_t stats[16];
+    const latency_stats_t *ping;
+    size_t n;
+
+    cacti_system_t *system = cacti_system_create(&parent, &parent_role, &config);
+    mu_assert("system not created", system != NULL);
+    cacti_system_join(system);
+
+    n = cacti_latency_snapshot(NULL, stats, 16);
+    ping = find(stats, n, &child_role, MSG_PING);
+    mu_assert("histograms of the systems were mixed", ping != NULL && ping->run.count == PINGS);
+    mu_assert("reported past the buffer", cacti_latency_snapshot(NULL, stats, 1) == n);
+
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(per_role_and_type);
+    mu_run_test(own_system);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,367 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_PING 1
+#define MSG_SPACE 2
+#define MSG_URGENT 2
+
+#define SENDERS 4
+#define BURSTS 200
+#define BURST 64            ///< more than the inline nodes, so every burst grows the mailbox
+
+#define LIMIT 4             ///< mailbox limit of the flow control tests
+#define WAIT_NS 20000000L
+#define TOTAL 100
+
+int tests_run = 0;
+
+static atomic_long received;
+
+static void nothing(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+}
+
+static void count(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    atomic_fetch_add(&received, 1);
+}
+
+static act_t counter_prompts[] = { nothing, count };
+static role_t counter_role = { .nprompts = 2, .prompts = counter_prompts };
+
+static atomic_int entered, released;
+
+// holds the only worker until released, so the mailbox cannot drain
+static void gate(void **stateptr, size_t nbytes, void *data) {
+    atomic_store(&entered, 1);
+    while (!atomic_load(&released))
+        usleep(1000);
+    count(stateptr, nbytes, data);
+}
+
+static act_t gate_prompts[] = { nothing, gate };
+static role_t gate_role = { .nprompts = 2, .prompts = gate_prompts };
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void *release_later(void *data) {
+    UNUSED_PARAMETER(data);
+    usleep(WAIT_NS / 1000);
+    atomic_store(&released, 1);
+    return NULL;
+}
+
+static role_t sink_role;
+static long produced, notified;
+static int wrong_notification;
+
+// sends until the sink is full, then waits for MSG_SPACE to go on
+static void produce(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    actor_id_t sink = (actor_id_t) *stateptr;
+    int res = 0;
+
+    if (data != NULL && (actor_id_t) data != sink)
+        wrong_notification = 1;
+
+    while (produced < TOTAL && (res = send_message(sink, (message_t) { .message_type = MSG_PING })) == 0)
+        ++produced;
+
+    if (produced < TOTAL) {
+        if (res != -3 || notify_on_space(sink, MSG_SPACE) != 0)
+            wrong_notification = 1;
+        return;
+    }
+
+    send_message(sink, (message_t) { .message_type = MSG_GODIE });
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static void producer_hello(void **stateptr, size_t nbytes, void *data) {
+    *stateptr = (void*) actor_spawn(&sink_role, NULL);
+    produce(stateptr, nbytes, data);
+}
+
+static void producer_space(void **stateptr, size_t nbytes, void *data) {
+    ++notified;
+    produce(stateptr, nbytes, data);
+}
+
+static atomic_int hellos, log_length;
+static char log_text[16];
+
+static void logged_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    atomic_fetch_add(&hellos, 1);
+}
+
+// the tag of the actor, its state, in lower case for ordinary messages and in upper case for urgent ones
+static void append(void **stateptr, char offset) {
+    int i = atomic_fetch_add(&log_length, 1);
+    if (i < (int) sizeof(log_text) - 1)
+        log_text[i] = (char) ((long) *stateptr + offset);
+}
+
+static void log_normal(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    append(stateptr, 0);
+}
+
+static void log_urgent(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    append(stateptr, 'A' - 'a');
+}
+
+static act_t log_prompts[] = { logged_hello, log_normal, log_urgent };
+static role_t log_role = { .nprompts = 3, .prompts = log_prompts };
+
+/// creates the default system with one worker and spawns actors of log_role tagged with the given letters
+static int start_logged(actor_id_t *gate_actor, const char *tags, actor_id_t *actors) {
+    size_t i;
+    actor_system_config_t config = { .n_workers = 1, .mailbox_limit = LIMIT };
+
+    atomic_store(&received, 0);
+    atomic_store(&entered, 0);
+    atomic_store(&released, 0);
+    atomic_store(&hellos, 0);
+    atomic_store(&log_length, 0);
+    memset(log_text, 0, sizeof(log_text));
+
+    if (actor_system_create_ex(gate_actor, &gate_role, &config) != 0)
+        return -1;
+
+    for (i = 0; i < strlen(tags); ++i)
+        actors[i] = actor_spawn(&log_role, (void*) (long) tags[i]);
+    while (atomic_load(&hellos) < (int) strlen(tags))
+        usleep(1000);
+
+    return 0;
+}
+
+/// keeps the only worker in the gate actor until released
+static int hold_worker(actor_id_t gate_actor) {
+    if (send_message(gate_actor, (message_t) { .message_type = MSG_PING }) != 0)
+        return -1;
+    while (!atomic_load(&entered))
+        usleep(1000);
+    return 0;
+}
+
+typedef struct sender {
+    cacti_system_t *system;
+    actor_id_t receiver;
+} sender_t;
+
+// bursts with pauses in between, so the receiver drains and shrinks its mailbox while others push
+static void *send_bursts(void *data) {
+    sender_t *s = data;
+    int i, j;
+
+    for (i = 0; i < BURSTS; ++i) {
+        for (j = 0; j < BURST; ++j) {
+            while (cacti_send(s->system, s->receiver, (message_t) { .message_type = MSG_PING }) == -3)
+                sched_yield();
+        }
+        usleep(50 * (i % 4));
+    }
+
+    return NULL;
+}
+
+// senders reserving room while the receiver gives the grown mailbox back lose nothing
+static char *push_while_shrinking()
+{
+    int i;
+    pthread_t threads[SENDERS];
+    actor_system_config_t config = { .n_workers = 2 };
+    sender_t sender;
+
+    atomic_store(&received, 0);
+    sender.system = cacti_system_create(&sender.receiver, &counter_role, &config);
+    mu_assert("create failed", sender.system != NULL);
+
+    for (i = 0; i < SENDERS; ++i)
+        pthread_create(&threads[i], NULL, send_bursts, &sender);
+    for (i = 0; i < SENDERS; ++i)
+        pthread_join(threads[i], NULL);
+
+    mu_assert("godie failed", cacti_send(sender.system, sender.receiver, (message_t) { .message_type = MSG_GODIE }) == 0);
+    cacti_system_join(sender.system);
+
+    mu_assert("messages were lost", atomic_load(&received) == SENDERS * BURSTS * BURST);
+    return 0;
+}
+
+// a thread outside of the pool gets -3 at once from send_message_try, waits in send_message_timed
+// until the timeout while the mailbox stays full, and until the mailbox drains otherwise
+static char *send_timed_from_outside()
+{
+    int i, res = 0;
+    long start;
+    pthread_t releaser;
+    actor_id_t receiver;
+    actor_system_config_t config = { .n_workers = 1, .mailbox_limit = LIMIT };
+    message_t ping = { .message_type = MSG_PING };
+
+    atomic_store(&received, 0);
+    mu_assert("create failed", actor_system_create_ex(&receiver, &gate_role, &config) == 0);
+    mu_assert("send failed", send_message(receiver, ping) == 0);
+    while (!atomic_load(&entered))
+        usleep(1000);
+
+    for (i = 0; i <= LIMIT && (res = send_message_try(receiver, ping)) == 0; ++i);
+    mu_assert("the mailbox should be full", res == -3 && i < LIMIT);
+
+    start = now_ns();
+    mu_assert("try should not wait", send_message_try(receiver, ping) == -3 && now_ns() - start < WAIT_NS);
+
+    start = now_ns();
+    mu_assert("timed send should time out", send_message_timed(receiver, ping, WAIT_NS) == -3);
+    mu_assert("timed send gave up too early", now_ns() - start >= WAIT_NS);
+
+    start = now_ns();
+    pthread_create(&releaser, NULL, release_later, NULL);
+    mu_assert("timed send should get room", send_message_timed(receiver, ping, -1) == 0);
+    mu_assert("timed send did not wait", now_ns() - start >= WAIT_NS / 2);
+    pthread_join(releaser, NULL);
+
+    send_message(receiver, (message_t) { .message_type = MSG_GODIE });
+    actor_system_join(receiver);
+
+    mu_assert("wrong number of messages", atomic_load(&received) == i + 2);
+    return 0;
+}
+
+// an actor that found a mailbox full goes on once MSG_SPACE tells it there is room
+static char *notified_on_space()
+{
+    actor_id_t producer;
+    act_t producer_prompts[] = { producer_hello, nothing, producer_space };
+    role_t producer_role = { .nprompts = 3, .prompts = producer_prompts };
+    actor_system_config_t config = { .n_workers = 1, .mailbox_limit = LIMIT };
+
+    atomic_store(&received, 0);
+    sink_role = counter_role;
+    cacti_system_t *system = cacti_system_create(&producer, &producer_role, &config);
+    mu_assert("create failed", system != NULL);
+    cacti_system_join(system);
+
+    mu_assert("notification without the full actor", !wrong_notification);
+    mu_assert("the producer was never notified", notified > 0);
+    mu_assert("messages were lost", produced == TOTAL && atomic_load(&received) == TOTAL);
+    return 0;
+}
+
+// an urgent message is taken before the ordinary messages queued before it
+static char *urgent_overtakes()
+{
+    int i;
+    actor_id_t gate_actor, x;
+
+    mu_assert("create failed", start_logged(&gate_actor, "x", &x) == 0);
+    mu_assert("hold failed", hold_worker(gate_actor) == 0);
+
+    for (i = 0; i < 3; ++i)
+        mu_assert("send failed", send_message(x, (message_t) { .message_type = MSG_PING }) == 0);
+    mu_assert("urgent send failed", send_message_urgent(x, (message_t) { .message_type = MSG_URGENT }) == 0);
+
+    atomic_store(&released, 1);
+    send_message(x, (message_t) { .message_type = MSG_GODIE });
+    send_message(gate_actor, (message_t) { .message_type = MSG_GODIE });
+    actor_system_join(gate_actor);
+
+    mu_assert("the urgent message did not overtake", strcmp(log_text, "Xxxx") == 0);
+    return 0;
+}
+
+// an actor made runnable by an urgent message runs before one made runnable by an ordinary message
+static char *urgent_run_queue()
+{
+    actor_id_t gate_actor, actors[2];
+
+    mu_assert("create failed", start_logged(&gate_actor, "ab", actors) == 0);
+    mu_assert("hold failed", hold_worker(gate_actor) == 0);
+
+    mu_assert("send failed", send_message(actors[0], (message_t) { .message_type = MSG_PING }) == 0);
+    mu_assert("urgent send failed", send_message_urgent(actors[1], (message_t) { .message_type = MSG_URGENT }) == 0);
+
+    atomic_store(&released, 1);
+    send_message(actors[0], (message_t) { .message_type = MSG_GODIE });
+    send_message(actors[1], (message_t) { .message_type = MSG_GODIE });
+    send_message(gate_actor, (message_t) { .message_type = MSG_GODIE });
+    actor_system_join(gate_actor);
+
+    mu_assert("the urgent actor did not run first", strcmp(log_text, "Ba") == 0);
+    return 0;
+}
+
+// MSG_GODIE gets into a mailbox full at the mailbox limit
+static char *godie_into_full_mailbox()
+{
+    int i, res = 0;
+    actor_id_t gate_actor;
+    message_t ping = { .message_type = MSG_PING };
+
+    mu_assert("create failed", start_logged(&gate_actor, "", NULL) == 0);
+    mu_assert("hold failed", hold_worker(gate_actor) == 0);
+
+    for (i = 0; i <= LIMIT && (res = send_message(gate_actor, ping)) == 0; ++i);
+    mu_assert("the mailbox should be full", res == -3);
+    mu_assert("godie was rejected", send_message(gate_actor, (message_t) { .message_type = MSG_GODIE }) == 0);
+    mu_assert("the mailbox should still be full", send_message(gate_actor, ping) == -3);
+
+    atomic_store(&released, 1);
+    actor_system_join(gate_actor);
+
+    mu_assert("wrong number of messages", atomic_load(&received) == i + 1);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(push_while_shrinking);
+    mu_run_test(send_timed_from_outside);
+    mu_run_test(notified_on_space);
+    mu_run_test(urgent_overtakes);
+    mu_run_test(urgent_run_queue);
+    mu_run_test(godie_into_full_mailbox);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
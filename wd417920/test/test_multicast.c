@@ -0,0 +1,99 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define N_CHILDREN 100
+#define MSG_PAYLOAD 1
+
+int tests_run = 0;
+
+typedef struct payload {
+    char text[200];
+} payload_t;
+
+static role_t child_role;
+static atomic_int received;         ///< children that got the right payload
+static void* _Atomic first_copy;    ///< the copy the first child saw
+static atomic_int same_copy;        ///< children that saw the same copy
+static int results[N_CHILDREN + 1];
+static size_t accepted;
+
+static void child_payload(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    void *expected = NULL;
+
+    if (nbytes == sizeof(payload_t) && strcmp(((payload_t*) data)->text, "shared") == 0)
+        atomic_fetch_add(&received, 1);
+
+    if (atomic_compare_exchange_strong(&first_copy, &expected, data) || expected == data)
+        atomic_fetch_add(&same_copy, 1);
+}
+
+// sends one payload to all children and a dead id, then kills everybody at once
+static void parent_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    actor_id_t ids[N_CHILDREN + 1];
+    payload_t payload = { .text = "shared" };
+
+    if (actor_spawn_many(&child_role, N_CHILDREN, NULL, ids) != 0)
+        return;
+    ids[N_CHILDREN] = 1L << 31; // no such actor
+
+    accepted = send_multicast(ids, N_CHILDREN + 1, MSG_PAYLOAD, &payload, sizeof(payload), results);
+    send_multicast(ids, N_CHILDREN, MSG_GODIE, NULL, 0, NULL);
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static char *one_payload_for_all()
+{
+    int i;
+    actor_id_t parent;
+    act_t parent_prompts[] = { parent_hello };
+    act_t child_prompts[] = { NULL, child_payload };
+    role_t parent_role = { .nprompts = 1, .prompts = parent_prompts };
+    child_role = (role_t) { .nprompts = 2, .prompts = child_prompts };
+
+    atomic_store(&received, 0);
+    atomic_store(&same_copy, 0);
+    atomic_store(&first_copy, NULL);
+
+    mu_assert("create failed", actor_system_create(&parent, &parent_role) == 0);
+    actor_system_join(parent);
+
+    mu_assert("wrong number of receivers", accepted == N_CHILDREN);
+    for (i = 0; i < N_CHILDREN; ++i)
+        mu_assert("a child rejected the message", results[i] == 0);
+    mu_assert("a missing actor accepted the message", results[N_CHILDREN] == -2);
+    mu_assert("a child missed the payload", atomic_load(&received) == N_CHILDREN);
+    mu_assert("the payload was copied more than once", atomic_load(&same_copy) == N_CHILDREN);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(one_payload_for_all);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,196 @@
+#include "minunit.h"
+#include "queue.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+int tests_run = 0;
+
+static char *test(int *arr, int n) {
+    int i;
+    queue_t* kju = queue_init();
+
+    mu_assert("error init", kju != NULL);
+    mu_assert("error empty", queue_empty(kju) == 1);
+
+    message_t m;
+
+    for (i = 0; i < n; ++i) {
+        m.data = (arr + i);
+        mu_assert("error push", queue_push(kju, m) == 0);
+    }
+
+    for (i = 0; i < n; ++i) {
+        mu_assert("error empty for", queue_empty(kju) == 0);
+        mu_assert("error pop", queue_pop(kju, &m) == 0);
+        mu_assert("error pop", *(int*)m.data == arr[i]);
+    }
+
+    mu_assert("error pop empty", queue_pop(kju, &m) == -1);
+
+    mu_assert("error empty", queue_empty(kju) == 1);
+    mu_assert("error destroy", queue_destroy(kju) == 0);
+    return 0;
+}
+
+
+static char *test01()
+{
+    int arr[] = {132, 533, 5, 70, 1202, 123, 332, 12, 1, 324};
+    return test(arr, sizeof(arr)/ sizeof(int));
+}
+
+static char *test02()
+{
+    int arr[] = {32};
+    return test(arr, sizeof(arr)/ sizeof(int));
+}
+
+static char *test03()
+{
+    int arr[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 213, 1234, 3124,3224, 3214, 1234, 342,2341};
+    return test(arr, sizeof(arr)/ sizeof(int));
+}
+
+#define PRODUCERS 4
+#define PER_PRODUCER 100000
+
+static void *producer(void *data) {
+    queue_t *q = data;
+    long i;
+
+    for (i = 0; i < PER_PRODUCER; ++i) {
+        message_t m = { .message_type = (message_type_t) pthread_self(), .nbytes = i };
+        queue_push(q, m);
+    }
+
+    return NULL;
+}
+
+/// every producer's messages must come out complete and in its own order
+static char *test_producers()
+{
+    int i, j;
+    pthread_t tid[PRODUCERS];
+    size_t next[PRODUCERS] = { 0 };
+    queue_t *q = queue_init();
+    message_t m;
+
+    for (i = 0; i < PRODUCERS; ++i)
+        pthread_create(&tid[i], NULL, producer, q);
+
+    for (i = 0; i < PRODUCERS * PER_PRODUCER; ++i) {
+        while (queue_pop(q, &m) != 0);
+
+        for (j = 0; j < PRODUCERS; ++j)
+            if ((pthread_t) m.message_type == tid[j])
+                break;
+
+        mu_assert("error unknown producer", j < PRODUCERS);
+        mu_assert("error order", m.nbytes == next[j]++);
+    }
+
+    for (i = 0; i < PRODUCERS; ++i)
+        pthread_join(tid[i], NULL);
+
+    mu_assert("error empty", queue_empty(q) == 1);
+    mu_assert("error destroy", queue_destroy(q) == 0);
+    return 0;
+}
+
+/// the pool grows past the inline nodes during a burst and returns to them afterwards
+static char *test_grow_shrink()
+{
+    int i, round;
+    queue_t *q = queue_init();
+    message_t m;
+
+    mu_assert("error grown", queue_grown(q) == 0);
+
+    for (round = 0; round < 3; ++round) {
+        for (i = 0; i < 1000; ++i) {
+            m.nbytes = i;
+            mu_assert("error push", queue_push(q, m) == 0);
+        }
+
+        mu_assert("error grown", queue_grown(q) > 0);
+
+        for (i = 0; i < 1000; ++i) {
+            mu_assert("error pop", queue_pop(q, &m) == 0);
+            mu_assert("error order", m.nbytes == (size_t) i);
+        }
+
+        mu_assert("error shrink", queue_shrink(q) == 1);
+        mu_assert("error grown", queue_grown(q) == 0);
+        mu_assert("error empty", queue_empty(q) == 1);
+    }
+
+    mu_assert("error destroy", queue_destroy(q) == 0);
+    return 0;
+}
+
+static char *test_inline()
+{
+    int i;
+    char payload[MESSAGE_INLINE_MAX];
+    queue_t *q = queue_init();
+    message_t m = { .message_type = 7 };
+
+    for (i = 0; i < 100; ++i) {
+        memset(payload, i, sizeof(payload));
+        m.nbytes = i % (MESSAGE_INLINE_MAX + 1);
+        m.data = NULL;
+        mu_assert("error push", queue_push_inline(q, m, payload) == 0);
+    }
+
+    m.nbytes = MESSAGE_INLINE_MAX + 1;
+    mu_assert("error too big", queue_push_inline(q, m, payload) == -1);
+
+    m.nbytes = 0;
+    m.data = q;
+    mu_assert("error push", queue_push(q, m) == 0);
+
+    for (i = 0; i < 100; ++i) {
+        mu_assert("error pop", queue_pop(q, &m) == 0);
+        mu_assert("error nbytes", m.nbytes == (size_t) (i % (MESSAGE_INLINE_MAX + 1)));
+        mu_assert("error payload", m.nbytes == 0 || ((char*) m.data)[m.nbytes - 1] == i);
+    }
+
+    mu_assert("error pop", queue_pop(q, &m) == 0);
+    mu_assert("error pointer", m.data == q);
+
+    queue_shrink(q);
+    mu_assert("error destroy", queue_destroy(q) == 0);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(test01);
+    mu_run_test(test02);
+    mu_run_test(test03);
+    mu_run_test(test_producers);
+    mu_run_test(test_grow_shrink);
+    mu_run_test(test_inline);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
+
@@ -0,0 +1,179 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define N_CHILDREN 1000
+#define MSG_PING 1
+
+int tests_run = 0;
+
+static role_t child_role;
+static long states[N_CHILDREN];
+static atomic_int greeted;      ///< children that found their state and parent in MSG_HELLO
+static atomic_long parent_id;
+
+// checks that the state is in place before the first message and dies
+static void child_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    long *state = *stateptr;
+
+    if (state >= states && state < states + N_CHILDREN && *state == state - states
+            && (actor_id_t) data == atomic_load(&parent_id))
+        atomic_fetch_add(&greeted, 1);
+
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+// spawns all children at once and dies
+static void parent_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    int i;
+    void *initial[N_CHILDREN];
+    actor_id_t ids[N_CHILDREN];
+
+    for (i = 0; i < N_CHILDREN; ++i)
+        initial[i] = &states[i];
+
+    atomic_store(&parent_id, actor_id_self());
+    if (actor_spawn_many(&child_role, N_CHILDREN, initial, ids) != 0)
+        return; // the test fails, the children are missing
+
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static char *bulk_spawn_in_actor()
+{
+    int i;
+    actor_id_t parent;
+    act_t parent_prompts[] = { parent_hello };
+    act_t child_prompts[] = { child_hello };
+    role_t parent_role = { .nprompts = 1, .prompts = parent_prompts };
+    child_role = (role_t) { .nprompts = 1, .prompts = child_prompts };
+
+    for (i = 0; i < N_CHILDREN; ++i)
+        states[i] = i;
+    atomic_store(&greeted, 0);
+
+    mu_assert("create failed", actor_system_create(&parent, &parent_role) == 0);
+    actor_system_join(parent);
+
+    mu_assert("a child missed its state or parent", atomic_load(&greeted) == N_CHILDREN);
+    return 0;
+}
+
+static void idle_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+}
+
+static void die(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static char *spawn_outside_of_actors()
+{
+    actor_id_t first, child;
+    act_t first_prompts[] = { idle_hello, die };
+    act_t child_prompts[] = { child_hello };
+    role_t first_role = { .nprompts = 2, .prompts = first_prompts };
+    role_t role = { .nprompts = 1, .prompts = child_prompts };
+
+    states[0] = 0;
+    atomic_store(&greeted, 0);
+    atomic_store(&parent_id, -1);
+
+    // the first actor keeps the system alive until the child is there
+    mu_assert("create failed", actor_system_create(&first, &first_role) == 0);
+    child = actor_spawn(&role, &states[0]);
+    mu_assert("spawn failed", child >= 0 && child != first);
+    mu_assert("send failed", send_message(first, (message_t) { .message_type = 1 }) == 0);
+    actor_system_join(first);
+
+    mu_assert("the child missed its state", atomic_load(&greeted) == 1);
+    return 0;
+}
+
+static atomic_int pinged;
+
+static void ping(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    atomic_fetch_add(&pinged, 1);
+}
+
+// a dead actor's slot goes to the next spawn, and its old id does not reach the new actor
+static char *slot_reuse()
+{
+    int i;
+    actor_id_t first, old, young;
+    cacti_stats_t stats;
+    act_t prompts[] = { idle_hello, ping };
+    role_t role = { .nprompts = 2, .prompts = prompts };
+    message_t message = { .message_type = MSG_PING };
+
+    atomic_store(&pinged, 0);
+    mu_assert("create failed", actor_system_create(&first, &role) == 0);
+
+    old = actor_spawn(&role, NULL);
+    mu_assert("spawn failed", old >= 0);
+    mu_assert("send failed", send_message(old, message) == 0);
+    mu_assert("godie failed", send_message(old, (message_t) { .message_type = MSG_GODIE }) == 0);
+
+    // reclaimed once it has processed everything
+    for (i = 0; i < 5000 && actor_migrations(old) != -1; ++i)
+        usleep(1000);
+    mu_assert("the actor was not reclaimed", actor_migrations(old) == -1);
+
+    young = actor_spawn(&role, NULL);
+    mu_assert("the slot was not reused", (young & 0xffffffffL) == (old & 0xffffffffL) && young != old);
+
+    mu_assert("the old id still accepts messages", send_message(old, message) == -1);
+    mu_assert("the old id still accepts urgent messages", send_message_urgent(old, message) == -1);
+    mu_assert("the old id reads the new actor", actor_migrations(old) == -1 && actor_migrations(young) >= 0);
+    mu_assert("the new id does not work", send_message(young, message) == 0);
+
+    send_message(young, (message_t) { .message_type = MSG_GODIE });
+    send_message(first, (message_t) { .message_type = MSG_GODIE });
+    actor_system_join(first);
+
+    cacti_stats_snapshot(NULL, &stats);
+    mu_assert("a ping went astray", atomic_load(&pinged) == 2);
+    mu_assert("actors are left alive", stats.alive == 0);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(bulk_spawn_in_actor);
+    mu_run_test(spawn_outside_of_actors);
+    mu_run_test(slot_reuse);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,109 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_PING 1
+
+#define PINGS 20
+#define MAILBOX_LIMIT 8     ///< fewer than PINGS, the only worker is busy sending them
+
+int tests_run = 0;
+
+static role_t sink_role;
+static int accepted, rejected;
+static int own_stats = -2;
+static actor_stats_t sink_stats;
+
+static void die() {
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static void nothing(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+}
+
+// the last ping reads the counters of its actor
+static void sink_ping(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    own_stats = actor_stats(actor_id_self(), &sink_stats);
+}
+
+// fills the mailbox of a sink that cannot run meanwhile
+static void source_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    actor_id_t sink = actor_spawn(&sink_role, NULL);
+    int i, res;
+
+    for (i = 0; i < PINGS; ++i) {
+        res = send_message(sink, (message_t) { .message_type = MSG_PING });
+        accepted += res == 0;
+        rejected += res == -3;
+    }
+
+    send_message(sink, (message_t) { .message_type = MSG_GODIE });
+    die();
+}
+
+static char *counters_add_up()
+{
+    actor_id_t source;
+    cacti_stats_t stats;
+    act_t source_prompts[] = { source_hello };
+    act_t sink_prompts[] = { nothing, sink_ping };
+    role_t source_role = { .nprompts = 1, .prompts = source_prompts };
+    sink_role = (role_t) { .nprompts = 2, .prompts = sink_prompts };
+    actor_system_config_t config = { .n_workers = 1, .mailbox_limit = MAILBOX_LIMIT };
+
+    cacti_system_t *system = cacti_system_create(&source, &source_role, &config);
+    mu_assert("create failed", system != NULL);
+
+    cacti_stats_snapshot(system, &stats);
+    mu_assert("wrong number of workers", stats.workers == 1);
+
+    cacti_system_join(system);
+    cacti_stats_snapshot(NULL, &stats);
+
+    mu_assert("every ping should be accepted or rejected", accepted + rejected == PINGS && rejected > 0);
+    mu_assert("actor stats failed", own_stats == 0);
+#if CACTI_STATS
+    mu_assert("the sink should know how many pings waited", sink_stats.high_water >= accepted);
+    mu_assert("sent and processed differ", stats.sent == stats.processed && stats.sent >= accepted + 4);
+    mu_assert("wrong number of rejected sends", stats.rejected == rejected);
+    mu_assert("wrong high water mark", stats.mailbox_high_water >= accepted);
+    mu_assert("no activations", stats.activations >= 2 && stats.busy_ns > 0);
+#endif
+    mu_assert("actors are left", stats.alive == 0 && stats.run_queue == 0);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(counters_add_up);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
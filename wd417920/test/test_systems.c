@@ -0,0 +1,99 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_COUNT 1
+#define SELF_SENDS 1000     ///< messages an actor sends itself
+#define EXTERNAL_SENDS 100  ///< messages the main thread sends to each system
+
+int tests_run = 0;
+
+static atomic_int completed;        ///< actors that got all their messages
+static atomic_int n_seen;
+static cacti_system_t *seen[2];     ///< systems the actors ran in
+
+// counts messages, dies once it has got those it sent itself and those of the main thread
+static void count(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    long *counter = *stateptr;
+
+    if (++*counter == SELF_SENDS + EXTERNAL_SENDS) {
+        atomic_fetch_add(&completed, 1);
+        cacti_free(counter);
+        send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+    } else if (*counter < SELF_SENDS) {
+        // reaches the own system without naming it
+        send_message(actor_id_self(), (message_t) { .message_type = MSG_COUNT });
+    }
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    *stateptr = cacti_alloc(sizeof(long));
+    *(long*) *stateptr = 0;
+    seen[atomic_fetch_add(&n_seen, 1)] = cacti_system_self();
+
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_COUNT });
+}
+
+static char *two_systems_at_once()
+{
+    int i;
+    actor_id_t first_a, first_b;
+    act_t prompts[] = { hello, count };
+    role_t role = { .nprompts = 2, .prompts = prompts };
+    actor_system_config_t config = { .n_workers = 2 };
+
+    atomic_store(&completed, 0);
+    atomic_store(&n_seen, 0);
+
+    cacti_system_t *a = cacti_system_create(&first_a, &role, &config);
+    cacti_system_t *b = cacti_system_create(&first_b, &role, &config);
+    mu_assert("create failed", a != NULL && b != NULL);
+    mu_assert("ids should not depend on other systems", first_a == first_b);
+
+    for (i = 0; i < EXTERNAL_SENDS; ++i) {
+        mu_assert("send to a failed",
+                  cacti_send_timed(a, first_a, (message_t) { .message_type = MSG_COUNT }, -1) == 0);
+        mu_assert("send to b failed",
+                  cacti_send_timed(b, first_b, (message_t) { .message_type = MSG_COUNT }, -1) == 0);
+    }
+
+    cacti_system_join(a);
+    cacti_system_join(b);
+
+    mu_assert("outside of actors there is no own system", cacti_system_self() == NULL);
+    mu_assert("an actor did not get all messages", atomic_load(&completed) == 2);
+    mu_assert("actors ran in wrong systems",
+              (seen[0] == a && seen[1] == b) || (seen[0] == b && seen[1] == a));
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(two_systems_at_once);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,249 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_TICK 1
+#define MSG_CHECK 2
+#define MSG_RECHECK 3
+
+#define DELAYS 3
+#define TICKS 5
+#define MS 1000000L
+#define IDLE_MS 300         ///< longer than the first level of the wheel
+#define LATE_MS 20
+
+int tests_run = 0;
+
+static long started;
+static long delays[DELAYS] = { 30 * MS, 10 * MS, 20 * MS };
+static long arrived[DELAYS];        ///< time since start each delayed message came at
+static int order[DELAYS];           ///< indices of the delayed messages, as they came
+static int n_ticks;
+static int ticks_at_check;
+static int ticks_at_recheck;
+static int cancelled[2];            ///< results of two cancels of the same timer
+static timer_id_t timer;
+static long late_by;                ///< how long after its delay the message after an idle gap came
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void die() {
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static void delayed_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    long i;
+
+    started = now_ns();
+    for (i = 0; i < DELAYS; ++i)
+        send_message_after(actor_id_self(), (message_t) { .message_type = MSG_TICK, .data = (void*) i }, delays[i]);
+}
+
+static void delayed_tick(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+
+    arrived[n_ticks] = now_ns() - started;
+    order[n_ticks]   = (int) (long) data;
+
+    if (++n_ticks == DELAYS)
+        die();
+}
+
+// three messages sent with different delays come in the order of their delays, not before them
+static char *delayed_messages()
+{
+    int i;
+    actor_id_t actor;
+    act_t prompts[] = { delayed_hello, delayed_tick };
+    role_t role = { .nprompts = 2, .prompts = prompts };
+
+    n_ticks = 0;
+    mu_assert("create failed", actor_system_create(&actor, &role) == 0);
+    actor_system_join(actor);
+
+    mu_assert("wrong number of messages", n_ticks == DELAYS);
+    mu_assert("wrong order", order[0] == 1 && order[1] == 2 && order[2] == 0);
+    for (i = 0; i < DELAYS; ++i)
+        mu_assert("message came too early", arrived[i] >= delays[order[i]]);
+    return 0;
+}
+
+static void periodic_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    timer = send_message_every(actor_id_self(), (message_t) { .message_type = MSG_TICK }, 0, 5 * MS);
+}
+
+static void periodic_tick(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    if (++n_ticks < TICKS)
+        return;
+
+    if (n_ticks == TICKS) {
+        cancelled[0] = cancel_timer(timer);
+        send_message_after(actor_id_self(), (message_t) { .message_type = MSG_CHECK }, 50 * MS);
+    }
+}
+
+static void check(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    ticks_at_check = n_ticks;
+    die();
+}
+
+// ticks already in the mailbox at the cancel have come by now, the count has to stay
+static void first_check(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    ticks_at_check = n_ticks;
+    send_message_after(actor_id_self(), (message_t) { .message_type = MSG_RECHECK }, 50 * MS);
+}
+
+static void recheck(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    ticks_at_recheck = n_ticks;
+    die();
+}
+
+// a periodic timer keeps sending until it is cancelled
+static char *periodic_messages()
+{
+    actor_id_t actor;
+    act_t prompts[] = { periodic_hello, periodic_tick, first_check, recheck };
+    role_t role = { .nprompts = 4, .prompts = prompts };
+
+    n_ticks = 0;
+    ticks_at_check = ticks_at_recheck = -1;
+    mu_assert("create failed", actor_system_create(&actor, &role) == 0);
+    actor_system_join(actor);
+
+    mu_assert("timer was not created", timer >= 0);
+    mu_assert("cancel failed", cancelled[0] == 0);
+    mu_assert("too few ticks", ticks_at_check >= TICKS);
+    mu_assert("ticks after cancel", ticks_at_recheck == ticks_at_check);
+    return 0;
+}
+
+static void cancel_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    timer = send_message_after(actor_id_self(), (message_t) { .message_type = MSG_TICK }, 10 * MS);
+    cancelled[0] = cancel_timer(timer);
+    cancelled[1] = cancel_timer(timer);
+    send_message_after(actor_id_self(), (message_t) { .message_type = MSG_CHECK }, 30 * MS);
+}
+
+// a message cancelled before its time never comes
+static char *cancelled_message()
+{
+    actor_id_t actor;
+    act_t prompts[] = { cancel_hello, delayed_tick, check };
+    role_t role = { .nprompts = 3, .prompts = prompts };
+
+    n_ticks = 0;
+    ticks_at_check = -1;
+    mu_assert("create failed", actor_system_create(&actor, &role) == 0);
+    actor_system_join(actor);
+
+    mu_assert("cancel failed", cancelled[0] == 0);
+    mu_assert("cancelled twice", cancelled[1] == -1);
+    mu_assert("cancelled message came", ticks_at_check == 0);
+    return 0;
+}
+
+static void idle_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    send_message_after(actor_id_self(), (message_t) { .message_type = MSG_TICK }, MS);
+}
+
+// the timer thread has nothing to do for a while after the first message
+static void idle_tick(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = IDLE_MS * MS };
+
+    nanosleep(&ts, NULL);
+    started = now_ns();
+    send_message_after(actor_id_self(), (message_t) { .message_type = MSG_CHECK }, 5 * MS);
+}
+
+static void idle_check(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+
+    late_by = now_ns() - started - 5 * MS;
+    die();
+}
+
+// a timer set after the wheel has been empty for a while comes on time
+static char *after_idle()
+{
+    actor_id_t actor;
+    act_t prompts[] = { idle_hello, idle_tick, idle_check };
+    role_t role = { .nprompts = 3, .prompts = prompts };
+
+    late_by = -1;
+    mu_assert("create failed", actor_system_create(&actor, &role) == 0);
+    actor_system_join(actor);
+
+    mu_assert("message came too early", late_by >= 0);
+    mu_assert("message came late", late_by < LATE_MS * MS);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(delayed_messages);
+    mu_run_test(periodic_messages);
+    mu_run_test(cancelled_message);
+    mu_run_test(after_idle);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
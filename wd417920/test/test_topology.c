@@ -0,0 +1,258 @@
+#include "minunit.h"
+#include "cacti.h"
+#include "topology.h"
+#include "scheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sched.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_BLOCK 1
+#define MSG_PING 1
+
+#define WAIT_US 500000      ///< how long a step may take before the test gives up
+
+int tests_run = 0;
+
+static int has_cpu(const cpu_mask_t *mask, int cpu) {
+    return (mask->cpus[cpu / 64] & (1ULL << (cpu % 64))) != 0;
+}
+
+/// whether a mask holds exactly the CPUs of a list ending with -1
+static int mask_is(const cpu_mask_t *mask, const int *cpus) {
+    int cpu, i, count = 0;
+
+    for (i = 0; cpus[i] >= 0; ++i)
+        if (!has_cpu(mask, cpus[i]))
+            return 0;
+
+    for (cpu = 0; cpu < CPU_MASK_MAX; ++cpu)
+        count += has_cpu(mask, cpu);
+
+    return count == i;
+}
+
+// the fixture has node0 "0-3,8,10-11", node2 without CPUs, node5 "4-5" and node10 "6"
+static char *sysfs_nodes()
+{
+    int node0[] = { 0, 1, 2, 3, 8, 10, 11, -1 };
+    int node5[] = { 4, 5, -1 };
+    int node10[] = { 6, -1 };
+    cpu_mask_t mask;
+
+    mu_assert("memory-only nodes should be left out", topology_nodes() == 3);
+    mu_assert("ranges and single CPUs", mask_is(topology_node_cpus(0), node0));
+    mu_assert("nodes should be numbered densely", mask_is(topology_node_cpus(1), node5));
+    mu_assert("nodes should be sorted by number", mask_is(topology_node_cpus(2), node10));
+
+    mu_assert("wrong node of a CPU", topology_node_of_cpu(10) == 0 && topology_node_of_cpu(5) == 1
+                                     && topology_node_of_cpu(6) == 2);
+    mu_assert("unknown CPUs belong to node 0", topology_node_of_cpu(9) == 0 && topology_node_of_cpu(-1) == 0);
+
+    memset(&mask, 0, sizeof(mask));
+    cpu_mask_set(&mask, 6);
+    cpu_mask_set(&mask, 8);
+    mu_assert("a mask belongs to the node of its first CPU", topology_node_of_mask(&mask) == 2);
+    return 0;
+}
+
+// ON_NODE(n) places on the workers of node n modulo the nodes, which take turns
+static char *placement()
+{
+    int node[] = { 0, 0, 1, 1 };
+    int i, seen[4] = { 0 };
+    scheduler_t *s = scheduler_init(4, node);
+
+    for (i = 0; i < 8; ++i)
+        seen[scheduler_place(s, ON_NODE(1) - 1)]++;
+    mu_assert("placed off the node", seen[0] == 0 && seen[1] == 0);
+    mu_assert("the workers of the node should take turns", seen[2] > 0 && seen[3] > 0);
+
+    mu_assert("nodes should wrap around", scheduler_node(s, scheduler_place(s, ON_NODE(2) - 1)) == 0);
+    mu_assert("wrong node of a worker", scheduler_node(s, 3) == 1);
+
+    scheduler_destroy(s);
+    return 0;
+}
+
+typedef struct gate {
+    atomic_int entered;
+    atomic_int released;
+    atomic_int done;
+    struct gate *frees;     ///< gate released once this one is entered, NULL if none
+} gate_t;
+
+static gate_t x_gate, y_gate;
+static atomic_int pings;
+static atomic_long moved;    ///< migrations of the probe, as it saw them at its last ping
+
+static void nothing(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+}
+
+// holds its worker until released
+static void block(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    gate_t *gate = *stateptr;
+
+    atomic_store(&gate->entered, 1);
+    if (gate->frees != NULL)
+        atomic_store(&gate->frees->released, 1);
+    while (!atomic_load(&gate->released))
+        usleep(100);
+    atomic_store(&gate->done, 1);
+}
+
+static void ping(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    atomic_store(&moved, actor_migrations(actor_id_self()));
+    atomic_fetch_add(&pings, 1);
+}
+
+/// waits until a flag reaches a value, 0 if it did in time
+static int wait_for(atomic_int *flag, int value) {
+    int i;
+
+    for (i = 0; i < WAIT_US / 1000 && atomic_load(flag) < value; ++i)
+        usleep(1000);
+    return atomic_load(flag) >= value ? 0 : -1;
+}
+
+// an actor sticks to its worker, and moves once that worker is stuck in a long callback
+static char *migrations()
+{
+    actor_id_t keeper, x, y, s;
+    cpu_mask_t masks[2];
+    act_t blocker_prompts[] = { nothing, block };
+    act_t probe_prompts[] = { nothing, ping };
+    role_t keeper_role = { .nprompts = 1, .prompts = probe_prompts };
+    role_t blocker_role = { .nprompts = 2, .prompts = blocker_prompts };
+    role_t probe_role = { .nprompts = 2, .prompts = probe_prompts };
+    message_t block_message = { .message_type = MSG_BLOCK };
+
+    // both workers on CPU 0, which every machine has, so the fixture's nodes are not used for pinning
+    memset(masks, 0, sizeof(masks));
+    cpu_mask_set(&masks[0], 0);
+    cpu_mask_set(&masks[1], 0);
+    actor_system_config_t config = { .n_workers = 2, .affinity = masks };
+
+    cacti_system_t *system = cacti_system_create(&keeper, &keeper_role, &config);
+    mu_assert("create failed", system != NULL);
+
+    // with one worker held by y, s and then x can only run on the other one, which becomes their home
+    y = cacti_spawn(system, &blocker_role, &y_gate);
+    mu_assert("block failed", cacti_send(system, y, block_message) == 0 && wait_for(&y_gate.entered, 1) == 0);
+
+    s = cacti_spawn(system, &probe_role, NULL);
+    mu_assert("ping failed", cacti_send(system, s, (message_t) { .message_type = MSG_PING }) == 0
+                             && wait_for(&pings, 1) == 0);
+
+    x = cacti_spawn(system, &blocker_role, &x_gate);
+    mu_assert("block failed", cacti_send(system, x, block_message) == 0 && wait_for(&x_gate.entered, 1) == 0);
+
+    atomic_store(&y_gate.released, 1);
+    mu_assert("y did not finish", wait_for(&y_gate.done, 1) == 0);
+    mu_assert("s should have stayed on its worker", atomic_load(&moved) == 0);
+
+    // s goes to the inbox of the worker x holds, the free worker has to take it from there
+    usleep(5000);
+    mu_assert("ping failed", cacti_send(system, s, (message_t) { .message_type = MSG_PING }) == 0);
+    mu_assert("s waited for the long callback", wait_for(&pings, 2) == 0 && !atomic_load(&x_gate.done));
+    mu_assert("s should have moved once", atomic_load(&moved) == 1);
+
+    atomic_store(&x_gate.released, 1);
+    cacti_send(system, x, (message_t) { .message_type = MSG_GODIE });
+    cacti_send(system, y, (message_t) { .message_type = MSG_GODIE });
+    cacti_send(system, s, (message_t) { .message_type = MSG_GODIE });
+    cacti_send(system, keeper, (message_t) { .message_type = MSG_GODIE });
+    cacti_system_join(system);
+
+    return 0;
+}
+
+// the inbox of a worker that has just started a long callback opens later, and the idle
+// worker has to wake up for it instead of sleeping until somebody pushes again
+static char *ping_early_in_callback()
+{
+    actor_id_t keeper, x, y, s;
+    cpu_mask_t masks[2];
+    act_t blocker_prompts[] = { nothing, block };
+    act_t probe_prompts[] = { nothing, ping };
+    role_t keeper_role = { .nprompts = 1, .prompts = probe_prompts };
+    role_t blocker_role = { .nprompts = 2, .prompts = blocker_prompts };
+    role_t probe_role = { .nprompts = 2, .prompts = probe_prompts };
+    message_t block_message = { .message_type = MSG_BLOCK };
+
+    memset(&x_gate, 0, sizeof(gate_t));
+    memset(&y_gate, 0, sizeof(gate_t));
+    x_gate.frees = &y_gate;
+    atomic_store(&pings, 0);
+
+    memset(masks, 0, sizeof(masks));
+    cpu_mask_set(&masks[0], 0);
+    cpu_mask_set(&masks[1], 0);
+    actor_system_config_t config = { .n_workers = 2, .affinity = masks };
+
+    cacti_system_t *system = cacti_system_create(&keeper, &keeper_role, &config);
+    mu_assert("create failed", system != NULL);
+
+    y = cacti_spawn(system, &blocker_role, &y_gate);
+    mu_assert("block failed", cacti_send(system, y, block_message) == 0 && wait_for(&y_gate.entered, 1) == 0);
+
+    s = cacti_spawn(system, &probe_role, NULL);
+    x = cacti_spawn(system, &blocker_role, &x_gate);
+    mu_assert("ping failed", cacti_send(system, s, (message_t) { .message_type = MSG_PING }) == 0
+                             && wait_for(&pings, 1) == 0);
+
+    // x holds the home of s and lets y go, the ping comes within the first millisecond of x
+    mu_assert("block failed", cacti_send(system, x, block_message) == 0);
+    while (!atomic_load(&x_gate.entered))
+        sched_yield();
+    mu_assert("ping failed", cacti_send(system, s, (message_t) { .message_type = MSG_PING }) == 0);
+
+    mu_assert("s waited for the long callback", wait_for(&pings, 2) == 0 && !atomic_load(&x_gate.done));
+    mu_assert("s should have moved once", atomic_load(&moved) == 1);
+
+    atomic_store(&x_gate.released, 1);
+    cacti_send(system, x, (message_t) { .message_type = MSG_GODIE });
+    cacti_send(system, y, (message_t) { .message_type = MSG_GODIE });
+    cacti_send(system, s, (message_t) { .message_type = MSG_GODIE });
+    cacti_send(system, keeper, (message_t) { .message_type = MSG_GODIE });
+    cacti_system_join(system);
+
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(sysfs_nodes);
+    mu_run_test(placement);
+    mu_run_test(migrations);
+    mu_run_test(ping_early_in_callback);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
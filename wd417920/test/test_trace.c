@@ -0,0 +1,151 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNUSED_PARAMETER(x) (void)(x)
+
+#define MSG_PING 1
+
+#define PINGS 10
+#define TRACE_PATH "test_trace.json"
+
+int tests_run = 0;
+
+static role_t child_role;
+
+static void die() {
+    send_message(actor_id_self(), (message_t) { .message_type = MSG_GODIE });
+}
+
+static void nothing(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+}
+
+static void parent_hello(void **stateptr, size_t nbytes, void *data) {
+    UNUSED_PARAMETER(stateptr);
+    UNUSED_PARAMETER(nbytes);
+    UNUSED_PARAMETER(data);
+    actor_id_t child = actor_spawn(&child_role, NULL);
+    int i;
+
+    for (i = 0; i < PINGS; ++i)
+        send_message(child, (message_t) { .message_type = MSG_PING });
+
+    send_message(child, (message_t) { .message_type = MSG_GODIE });
+    die();
+}
+
+static void run_system() {
+    actor_id_t parent;
+    act_t parent_prompts[] = { parent_hello };
+    act_t child_prompts[] = { nothing, nothing };
+    role_t parent_role = { .nprompts = 1, .prompts = parent_prompts };
+    child_role = (role_t) { .nprompts = 2, .prompts = child_prompts };
+
+    actor_system_create(&parent, &parent_role);
+    actor_system_join(parent);
+}
+
+/// the dump as a string, NULL if it could not be read
+static char *read_dump() {
+    FILE *f = fopen(TRACE_PATH, "r");
+    char *text;
+    long size;
+
+    if (f == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+
+    text = malloc(size + 1);
+    text[fread(text, 1, size, f)] = '\0';
+    fclose(f);
+    return text;
+}
+
+static int occurrences(const char *text, const char *pattern) {
+    int n = 0;
+
+    while ((text = strstr(text, pattern)) != NULL) {
+        ++n;
+        text += strlen(pattern);
+    }
+
+    return n;
+}
+
+// the trace of a finished system shows what its workers did
+static char *dump_after_join()
+{
+    char *text;
+
+    run_system();
+
+    mu_assert("dump failed", cacti_trace_dump(TRACE_PATH) == 0);
+    mu_assert("dump is unreadable", (text = read_dump()) != NULL);
+
+    mu_assert("not a trace", strncmp(text, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 38) == 0);
+    mu_assert("workers are not named", strstr(text, "\"name\":\"default/0\"") != NULL);
+    mu_assert("spawns are missing", occurrences(text, "\"name\":\"spawn\"") >= 2);
+    mu_assert("sends are missing", occurrences(text, "\"name\":\"send\"") >= PINGS + 2);
+    mu_assert("scheduling is missing", strstr(text, "\"name\":\"schedule\"") != NULL);
+    mu_assert("deaths are missing", occurrences(text, "\"name\":\"godie\"") == 2);
+    mu_assert("callbacks do not begin and end",
+              occurrences(text, "\"name\":\"dispatch\",\"cat\":\"cacti\",\"ph\":\"B\"") == PINGS + 4
+              && occurrences(text, "\"name\":\"dispatch\",\"cat\":\"cacti\",\"ph\":\"E\"") == PINGS + 4);
+
+    free(text);
+    return 0;
+}
+
+// nothing is recorded while tracing is paused
+static char *paused()
+{
+    char *text;
+    int before;
+
+    mu_assert("dump failed", cacti_trace_dump(TRACE_PATH) == 0 && (text = read_dump()) != NULL);
+    before = occurrences(text, "\"name\":\"send\"");
+    free(text);
+
+    cacti_trace_enable(0);
+    run_system();
+    cacti_trace_enable(1);
+
+    mu_assert("dump failed", cacti_trace_dump(TRACE_PATH) == 0 && (text = read_dump()) != NULL);
+    mu_assert("recorded while paused", occurrences(text, "\"name\":\"send\"") == before);
+
+    free(text);
+    remove(TRACE_PATH);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(dump_after_join);
+    mu_run_test(paused);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,312 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+
+#include "timer.h"
+#include "err.h"
+
+#define TIMER_MASK (TIMER_SLOTS - 1)
+#define ID_INDEX 0xffffffffL    ///< bits of a timer id holding its entry, the bits above hold its generation
+
+/// a timer that has expired, delivered after the lock is released
+typedef struct timer_fired {
+    long id;
+    long period;
+    actor_id_t actor;
+    message_t message;
+} timer_fired_t;
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/// the tick the clock is at, the wheel may lag behind it
+static inline long current_tick(timer_service_t *t) {
+    return (now_ns() - t->start_ns) / TIMER_TICK_NS;
+}
+
+/// the slot a timer due at the given tick belongs to, as seen from the last tick processed
+static timer_entry_t** slot_for(timer_service_t *t, long due) {
+    int level;
+    long delta = due - t->now;
+
+    for (level = 0; level < TIMER_LEVELS - 1; ++level)
+        if (delta < 1L << ((level + 1) * TIMER_LEVEL_BITS))
+            break;
+
+    // too far for the wheel, the timer goes round the last level until it gets closer
+    if (delta >= 1L << (TIMER_LEVELS * TIMER_LEVEL_BITS))
+        due = t->now + (1L << (TIMER_LEVELS * TIMER_LEVEL_BITS)) - 1;
+
+    return &t->slots[level][(due >> (level * TIMER_LEVEL_BITS)) & TIMER_MASK];
+}
+
+static void link_entry(timer_service_t *t, timer_entry_t *e) {
+    timer_entry_t **slot = slot_for(t, e->due);
+
+    e->slot = slot;
+    e->prev = NULL;
+    e->next = *slot;
+    if (*slot != NULL)
+        (*slot)->prev = e;
+    *slot = e;
+}
+
+static void unlink_entry(timer_entry_t *e) {
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        *e->slot = e->next;
+
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+
+    e->slot = NULL;
+}
+
+/// gives an entry back, ids of its last timer never match it again
+static void free_entry(timer_service_t *t, timer_entry_t *e) {
+    e->id       += 1L << 32;
+    e->next_free = t->free_entries;
+    t->free_entries = e->id & ID_INDEX;
+    t->pending--;
+}
+
+/**
+ * Processes the next tick: moves the timers of the levels that have wrapped around
+ * one level down and takes the timers that expire.
+ * @param[in,out] fired     expired timers are appended to it
+ */
+static void advance(timer_service_t *t, timer_fired_t **fired, long *n_fired, long *capacity) {
+    int level;
+    timer_entry_t *e, *next;
+    long tick = ++t->now;
+
+    for (level = 1; level < TIMER_LEVELS; ++level) {
+        if ((tick & ((1L << (level * TIMER_LEVEL_BITS)) - 1)) != 0)
+            break;
+
+        timer_entry_t **slot = &t->slots[level][(tick >> (level * TIMER_LEVEL_BITS)) & TIMER_MASK];
+        for (e = *slot, *slot = NULL; e != NULL; e = next) {
+            next = e->next;
+            link_entry(t, e);
+        }
+    }
+
+    timer_entry_t **slot = &t->slots[0][tick & TIMER_MASK];
+    for (e = *slot, *slot = NULL; e != NULL; e = next) {
+        next = e->next;
+
+        if (*n_fired == *capacity) {
+            *capacity = *capacity * 2 + 16;
+            if ((*fired = realloc(*fired, *capacity * sizeof(timer_fired_t))) == NULL)
+                fatal("Out of memory");
+        }
+        (*fired)[(*n_fired)++] = (timer_fired_t) {
+            .id = e->id, .period = e->period, .actor = e->actor, .message = e->message
+        };
+
+        if (e->period > 0) {
+            e->due = tick + e->period;
+            link_entry(t, e);
+        } else {
+            e->slot = NULL;
+            free_entry(t, e);
+        }
+    }
+}
+
+/// the tick the thread has to wake up at: the next one with timers to expire or to move down
+static long next_wakeup(timer_service_t *t) {
+    long tick;
+
+    if (t->pending == 0)
+        return LONG_MAX;
+
+    for (tick = t->now + 1; ; ++tick)
+        if ((tick & TIMER_MASK) == 0 || t->slots[0][tick & TIMER_MASK] != NULL)
+            return tick;
+}
+
+/**
+ * Delivers a tick of a periodic timer unless the timer has been cancelled since the tick
+ * expired. The lock is held while it is sent, so nothing comes after timer_cancel returns 0.
+ */
+static void fire_periodic(timer_service_t *t, timer_fired_t *f) {
+    timer_entry_t *e;
+
+    safe_lock(&t->lock);
+    e = actor_table_get(t->entries, f->id & ID_INDEX);
+    if (e->id == f->id && e->slot != NULL && t->fire(t->arg, f->actor, f->message) != 0) {
+        unlink_entry(e); // the receiver is gone
+        free_entry(t, e);
+    }
+    safe_unlock(&t->lock);
+}
+
+/// the life of the timer thread
+static void *timer_thread(void *data) {
+    timer_service_t *t = data;
+    timer_fired_t *fired = NULL;
+    long i, n_fired = 0, capacity = 0, target;
+    struct timespec deadline;
+    int err;
+
+    safe_lock(&t->lock);
+
+    while (!t->stopped) {
+        target = current_tick(t);
+        if (t->pending == 0 && t->now < target)
+            t->now = target; // nothing to expire on the way
+
+        n_fired = 0;
+        while (t->now < target)
+            advance(t, &fired, &n_fired, &capacity);
+
+        if (n_fired > 0) {
+            safe_unlock(&t->lock);
+            for (i = 0; i < n_fired; ++i) {
+                if (fired[i].period > 0)
+                    fire_periodic(t, &fired[i]);
+                else
+                    t->fire(t->arg, fired[i].actor, fired[i].message);
+            }
+            safe_lock(&t->lock);
+            continue;
+        }
+
+        t->wake_at = next_wakeup(t);
+        if (t->wake_at == LONG_MAX) {
+            err = pthread_cond_wait(&t->changed, &t->lock);
+        } else {
+            long at = t->start_ns + t->wake_at * TIMER_TICK_NS;
+            deadline.tv_sec  = at / 1000000000L;
+            deadline.tv_nsec = at % 1000000000L;
+            err = pthread_cond_timedwait(&t->changed, &t->lock, &deadline);
+        }
+
+        if (err != 0 && err != ETIMEDOUT)
+            syserr(err, "cond wait failed");
+    }
+
+    safe_unlock(&t->lock);
+    free(fired);
+    return NULL;
+}
+
+timer_service_t* timer_service_init(timer_fire_t fire, void *arg) {
+    int err;
+    pthread_condattr_t attr;
+    timer_service_t *t = safe_malloc(sizeof(timer_service_t));
+
+    *t = (timer_service_t) {
+        .start_ns = now_ns(), .wake_at = LONG_MAX, .free_entries = -1, .fire = fire, .arg = arg
+    };
+    t->entries = actor_table_init(sizeof(timer_entry_t), TIMER_LIMIT);
+
+    if ((err = pthread_mutex_init(&t->lock, 0)) != 0)
+        syserr(err, "mutex init failed");
+
+    // deadlines are measured with the monotonic clock
+    if ((err = pthread_condattr_init(&attr)) != 0)
+        syserr(err, "condattr init failed");
+    if ((err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)) != 0)
+        syserr(err, "condattr setclock failed");
+    if ((err = pthread_cond_init(&t->changed, &attr)) != 0)
+        syserr(err, "cond init failed");
+    if ((err = pthread_condattr_destroy(&attr)) != 0)
+        syserr(err, "condattr destroy failed");
+
+    if ((err = pthread_create(&t->thread, NULL, timer_thread, t)) != 0)
+        syserr(err, "create");
+
+    return t;
+}
+
+long timer_add(timer_service_t *t, actor_id_t actor, message_t message, long delay_ns, long period_ns) {
+    int err;
+    long index;
+    timer_entry_t *e;
+
+    safe_lock(&t->lock);
+
+    if ((index = t->free_entries) >= 0) {
+        e = actor_table_get(t->entries, index);
+        t->free_entries = e->next_free;
+    } else if ((index = actor_table_reserve(t->entries, 1)) >= 0) {
+        e = actor_table_get(t->entries, index);
+        e->id = index;
+    } else {
+        safe_unlock(&t->lock);
+        return -1;
+    }
+
+    // the first tick not before the delay has passed
+    long since = now_ns() - t->start_ns;
+    long tick  = since / TIMER_TICK_NS;
+    long due   = (since + (delay_ns > 0 ? delay_ns : 0) + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+
+    // an empty wheel is not processed while the thread sleeps, it starts again from the clock
+    // instead of making the thread go through every tick of the idle time
+    if (t->pending == 0 && t->now < tick)
+        t->now = tick;
+
+    e->due     = due > t->now ? due : t->now + 1;
+    e->period  = period_ns > 0 ? (period_ns + TIMER_TICK_NS - 1) / TIMER_TICK_NS : 0;
+    e->actor   = actor;
+    e->message = message;
+    link_entry(t, e);
+    t->pending++;
+
+    // the thread sleeps past the new timer
+    if (e->due < t->wake_at && (err = pthread_cond_signal(&t->changed)) != 0)
+        syserr(err, "cond signal failed");
+
+    long id = e->id;
+    safe_unlock(&t->lock);
+    return id;
+}
+
+int timer_cancel(timer_service_t *t, long id) {
+    timer_entry_t *e;
+    int res = -1;
+
+    if (id < 0)
+        return -1;
+
+    safe_lock(&t->lock);
+
+    if ((id & ID_INDEX) < actor_table_size(t->entries)
+            && (e = actor_table_get(t->entries, id & ID_INDEX))->id == id && e->slot != NULL) {
+        unlink_entry(e);
+        free_entry(t, e);
+        res = 0;
+    }
+
+    safe_unlock(&t->lock);
+    return res;
+}
+
+void timer_service_destroy(timer_service_t *t) {
+    int err;
+
+    safe_lock(&t->lock);
+    t->stopped = 1;
+    if ((err = pthread_cond_signal(&t->changed)) != 0)
+        syserr(err, "cond signal failed");
+    safe_unlock(&t->lock);
+
+    if ((err = pthread_join(t->thread, NULL)) != 0)
+        syserr(err, "join failed");
+
+    if ((err = pthread_cond_destroy(&t->changed)) != 0)
+        syserr(err, "cond destroy failed");
+    if ((err = pthread_mutex_destroy(&t->lock)) != 0)
+        syserr(err, "mutex destroy failed");
+
+    actor_table_destroy(t->entries);
+    free(t);
+}
@@ -0,0 +1,76 @@
+// Hierarchical timer wheel served by a thread of its own.
+//
+// Level 0 has a slot per tick, every next level has a slot per full turn of the
+// level below. A timer goes into the lowest level whose turn covers its delay
+// and moves down when the levels below wrap around, so inserting and cancelling
+// take constant time whatever the number of pending timers.
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <pthread.h>
+
+#include "cacti.h"
+#include "actor_table.h"
+
+#define TIMER_TICK_NS 1000000L          ///< resolution of timers, delays are rounded up to it
+#define TIMER_LEVEL_BITS 8
+#define TIMER_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_LEVELS 4                  ///< longer delays wait in the last level for several turns
+#define TIMER_LIMIT 0xffffffffL         ///< timers pending at once
+
+/**
+ * Delivers the message of a timer that has expired.
+ * @return      0 on success, o/w a periodic timer is cancelled
+ */
+typedef int (*timer_fire_t)(void *arg, actor_id_t actor, message_t message);
+
+typedef struct timer_entry {
+    long id;                        ///< id of the timer using the entry, its generation is bumped when it is done
+    long due;                       ///< tick the timer expires at
+    long period;                    ///< ticks between expirations, 0 if it expires once
+    actor_id_t actor;
+    message_t message;
+    struct timer_entry *prev;       ///< neighbours in the slot, prev is NULL for the first one
+    struct timer_entry *next;
+    struct timer_entry **slot;      ///< slot the entry is in, NULL if it is not pending
+    long next_free;                 ///< next entry of the free list while the entry is unused
+} timer_entry_t;
+
+typedef struct timer_service {
+    pthread_mutex_t lock;           ///< guards everything below
+    pthread_cond_t changed;         ///< the thread waits here for the next tick or an earlier timer
+    pthread_t thread;
+    int stopped;
+    long start_ns;                  ///< time of tick 0
+    long now;                       ///< last tick processed
+    long wake_at;                   ///< tick the thread sleeps until, LONG_MAX if there are no timers
+    long pending;                   ///< number of pending timers
+    timer_entry_t *slots[TIMER_LEVELS][TIMER_SLOTS];
+    actor_table_t *entries;
+    long free_entries;              ///< top of the free list, -1 if empty
+    timer_fire_t fire;
+    void *arg;
+} timer_service_t;
+
+/// starts the thread of a new service, which delivers messages with fire(arg, ...)
+extern timer_service_t* timer_service_init(timer_fire_t fire, void *arg);
+
+/**
+ * Arms a timer.
+ * @param delay_ns      time until the first expiration, rounded up to a tick
+ * @param period_ns     time between expirations, 0 to expire once
+ * @return              id of the timer, -1 if TIMER_LIMIT timers are pending
+ */
+extern long timer_add(timer_service_t *t, actor_id_t actor, message_t message, long delay_ns, long period_ns);
+
+/**
+ * Disarms a timer. Once it has succeeded, the timer fires no more.
+ * @return              0 on success, -1 if it has expired (for the last time) or been cancelled already
+ */
+extern int timer_cancel(timer_service_t *t, long id);
+
+/// stops the thread, pending timers never expire
+extern void timer_service_destroy(timer_service_t *t);
+
+#endif //TIMER_H
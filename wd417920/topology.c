@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "topology.h"
+#include "err.h"
+
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+static int n_nodes = 1;
+static cpu_mask_t node_cpus[TOPOLOGY_NODES_MAX];
+static unsigned char cpu_node[CPU_MASK_MAX];
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+/**
+ * Parses a list of CPUs like "0-3,8,10-11".
+ * @return      the number of CPUs in it
+ */
+static int parse_cpulist(FILE *f, cpu_mask_t *mask) {
+    int first, last, cpu, count = 0;
+    char sep;
+
+    while (fscanf(f, "%d", &first) == 1) {
+        last = first;
+        if (fscanf(f, "%c", &sep) == 1 && sep == '-') {
+            if (fscanf(f, "%d", &last) != 1)
+                break;
+            if (fscanf(f, "%c", &sep) != 1)
+                sep = '\n';
+        }
+
+        for (cpu = first; cpu <= last && cpu < CPU_MASK_MAX; ++cpu, ++count)
+            cpu_mask_set(mask, cpu);
+
+        if (sep != ',')
+            break;
+    }
+
+    return count;
+}
+
+static void read_topology() {
+    int ids[TOPOLOGY_NODES_MAX * 4];
+    int i, n_ids = 0, node = 0, cpu;
+    char path[256];
+    struct dirent *entry;
+    DIR *dir = opendir(TOPOLOGY_SYSFS);
+
+    if (dir == NULL)
+        return; // a single node, its CPUs are not needed
+
+    while ((entry = readdir(dir)) != NULL && n_ids < TOPOLOGY_NODES_MAX * 4)
+        if (strncmp(entry->d_name, "node", 4) == 0 && sscanf(entry->d_name + 4, "%d", &ids[n_ids]) == 1)
+            ++n_ids;
+    closedir(dir);
+
+    qsort(ids, n_ids, sizeof(int), compare_ints);
+
+    for (i = 0; i < n_ids; ++i) {
+        snprintf(path, sizeof(path), TOPOLOGY_SYSFS "/node%d/cpulist", ids[i]);
+        FILE *f = fopen(path, "r");
+        if (f == NULL)
+            continue;
+
+        cpu_mask_t mask;
+        memset(&mask, 0, sizeof(mask));
+        int count = parse_cpulist(f, &mask);
+        fclose(f);
+
+        if (count == 0)
+            continue; // memory without CPUs
+
+        int dense = node < TOPOLOGY_NODES_MAX ? node : TOPOLOGY_NODES_MAX - 1;
+        for (cpu = 0; cpu < CPU_MASK_MAX; ++cpu) {
+            if (mask.cpus[cpu / 64] & (1ULL << (cpu % 64))) {
+                cpu_mask_set(&node_cpus[dense], cpu);
+                cpu_node[cpu] = dense;
+            }
+        }
+        ++node;
+    }
+
+    if (node > 0)
+        n_nodes = node < TOPOLOGY_NODES_MAX ? node : TOPOLOGY_NODES_MAX;
+}
+
+static void init_topology() {
+    int err;
+    if ((err = pthread_once(&topology_once, read_topology)) != 0)
+        syserr(err, "once failed");
+}
+
+int topology_nodes() {
+    init_topology();
+    return n_nodes;
+}
+
+int topology_node_of_cpu(int cpu) {
+    init_topology();
+    return cpu >= 0 && cpu < CPU_MASK_MAX ? cpu_node[cpu] : 0;
+}
+
+int topology_node_of_mask(const cpu_mask_t *mask) {
+    int cpu;
+
+    for (cpu = 0; cpu < CPU_MASK_MAX; ++cpu)
+        if (mask->cpus[cpu / 64] & (1ULL << (cpu % 64)))
+            return topology_node_of_cpu(cpu);
+
+    return 0;
+}
+
+const cpu_mask_t* topology_node_cpus(int node) {
+    init_topology();
+    return &node_cpus[node];
+}
@@ -0,0 +1,29 @@
+// NUMA topology of the machine, read from sysfs the first time it is needed.
+//
+// Nodes are numbered densely from 0 in the order of their sysfs numbers, nodes
+// without CPUs are left out. A machine without sysfs looks like a single node.
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include "cacti.h"
+
+#ifndef TOPOLOGY_SYSFS
+#define TOPOLOGY_SYSFS "/sys/devices/system/node"
+#endif
+
+#define TOPOLOGY_NODES_MAX 64   ///< nodes beyond this many are merged into the last one
+
+/// number of nodes with CPUs, at least 1
+extern int topology_nodes();
+
+/// node of a CPU, 0 if the CPU is unknown
+extern int topology_node_of_cpu(int cpu);
+
+/// node of the first CPU of a mask
+extern int topology_node_of_mask(const cpu_mask_t *mask);
+
+/// CPUs of a node
+extern const cpu_mask_t* topology_node_cpus(int node);
+
+#endif //TOPOLOGY_H
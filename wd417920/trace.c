@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "err.h"
+
+#define TRACE_NAME_MAX 32
+
+atomic_int trace_enabled = 1;
+
+typedef struct trace_event {
+    atomic_long ts;             ///< monotonic time in nanoseconds
+    atomic_long actor;
+    atomic_long arg;
+    atomic_int tid;             ///< thread that recorded the event, rings change hands
+    atomic_int kind;            ///< the event in the lower byte, its phase in the one above
+} trace_event_t;
+
+typedef struct trace_ring {
+    trace_event_t events[TRACE_RING_SIZE];
+    atomic_ulong head;          ///< events recorded so far, the last TRACE_RING_SIZE of them are kept
+    int tid;                    ///< thread the ring belongs to now, guarded by rings_lock
+    int owned;                  ///< 0 once that thread has exited, guarded by rings_lock
+    struct trace_ring *next;
+} trace_ring_t;
+
+/// name of a thread, kept after it has exited, as its events may still be in some ring
+typedef struct trace_name {
+    int tid;
+    char name[TRACE_NAME_MAX];
+    struct trace_name *next;
+} trace_name_t;
+
+static const char *event_names[TRACE_EVENTS] = { "send", "schedule", "dispatch", "spawn", "godie", "parked" };
+static const char *arg_names[TRACE_EVENTS]   = { "type", "urgent", "type", NULL, NULL, NULL };
+
+static __thread trace_ring_t *own_ring = NULL;  ///< ring of the calling thread
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;                  ///< hands the ring over when its thread exits
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_ring_t *rings = NULL;              ///< rings of all threads that have recorded events
+static trace_name_t *names = NULL;              ///< names of threads, guarded by rings_lock
+
+static void abandon_ring(void *ring) {
+    own_ring = NULL;
+
+    safe_lock(&rings_lock);
+    ((trace_ring_t*) ring)->owned = 0;
+    safe_unlock(&rings_lock);
+}
+
+static void create_key() {
+    int err;
+    if ((err = pthread_key_create(&ring_key, abandon_ring)) != 0)
+        syserr(err, "key create failed");
+}
+
+/// ring of the calling thread, created or taken over on its first event
+static trace_ring_t* get_ring() {
+    int err;
+    trace_ring_t *ring;
+
+    if (own_ring != NULL)
+        return own_ring;
+
+    if ((err = pthread_once(&key_once, create_key)) != 0)
+        syserr(err, "once failed");
+
+    safe_lock(&rings_lock);
+    for (ring = rings; ring != NULL && ring->owned; ring = ring->next);
+
+    if (ring == NULL) {
+        ring = safe_malloc(sizeof(trace_ring_t));
+        memset(ring, 0, sizeof(trace_ring_t));
+        ring->next = rings;
+        rings      = ring;
+    }
+
+    ring->owned   = 1;
+    ring->tid     = (int) syscall(SYS_gettid);
+    safe_unlock(&rings_lock);
+
+    if ((err = pthread_setspecific(ring_key, ring)) != 0)
+        syserr(err, "setspecific failed");
+
+    return own_ring = ring;
+}
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void trace_record(int event, char phase, long actor, long arg) {
+    trace_ring_t *ring = get_ring();
+    unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    trace_event_t *e   = &ring->events[head & (TRACE_RING_SIZE - 1)];
+
+    atomic_store_explicit(&e->ts, now_ns(), memory_order_relaxed);
+    atomic_store_explicit(&e->actor, actor, memory_order_relaxed);
+    atomic_store_explicit(&e->arg, arg, memory_order_relaxed);
+    atomic_store_explicit(&e->tid, ring->tid, memory_order_relaxed);
+    atomic_store_explicit(&e->kind, event | phase << 8, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void trace_name_thread(const char *name) {
+    trace_name_t *n = safe_malloc(sizeof(trace_name_t));
+
+    n->tid = get_ring()->tid;
+    snprintf(n->name, TRACE_NAME_MAX, "%s", name);
+
+    safe_lock(&rings_lock);
+    n->next = names;
+    names   = n;
+    safe_unlock(&rings_lock);
+}
+
+/// an event copied out of a ring
+typedef struct trace_copy {
+    long ts, actor, arg;
+    int tid, kind;
+} trace_copy_t;
+
+/// writes the events of a ring that have not been overwritten, oldest first
+static void dump_ring(FILE *f, trace_ring_t *ring, int pid, int *first) {
+    trace_copy_t *copy = safe_malloc(TRACE_RING_SIZE * sizeof(trace_copy_t));
+    unsigned long i, head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned long base = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0, from = base;
+
+    for (i = base; i < head; ++i) {
+        trace_event_t *e = &ring->events[i & (TRACE_RING_SIZE - 1)];
+        copy[i - base] = (trace_copy_t) {
+                .ts    = atomic_load_explicit(&e->ts, memory_order_relaxed),
+                .actor = atomic_load_explicit(&e->actor, memory_order_relaxed),
+                .arg   = atomic_load_explicit(&e->arg, memory_order_relaxed),
+                .tid   = atomic_load_explicit(&e->tid, memory_order_relaxed),
+                .kind  = atomic_load_explicit(&e->kind, memory_order_relaxed)
+        };
+    }
+
+    // the owner may have overwritten the oldest events while they were copied
+    atomic_thread_fence(memory_order_acquire);
+    unsigned long now = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (now >= TRACE_RING_SIZE && now - TRACE_RING_SIZE + 1 > from)
+        from = now - TRACE_RING_SIZE + 1;
+
+    for (i = from; i < head; ++i) {
+        trace_copy_t *c = &copy[i - base];
+        int event  = c->kind & 0xff;
+        char phase = (char) (c->kind >> 8);
+
+        if (event >= TRACE_EVENTS)
+            continue;
+
+        fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"cacti\",\"ph\":\"%c\",%s\"ts\":%ld.%03ld,"
+                   "\"pid\":%d,\"tid\":%d,\"args\":{\"actor\":%ld",
+                *first ? "" : ",", event_names[event], phase, phase == TRACE_INSTANT ? "\"s\":\"t\"," : "",
+                c->ts / 1000, c->ts % 1000, pid, c->tid, c->actor);
+        if (arg_names[event] != NULL)
+            fprintf(f, ",\"%s\":%ld", arg_names[event], c->arg);
+        fprintf(f, "}}");
+        *first = 0;
+    }
+
+    free(copy);
+}
+
+int trace_dump(const char *path) {
+    int first = 1, pid = (int) getpid();
+    trace_ring_t *ring;
+    trace_name_t *n;
+    FILE *f = fopen(path, "w");
+
+    if (f == NULL)
+        return -1;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    safe_lock(&rings_lock);
+    for (n = names; n != NULL; n = n->next) {
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",", pid, n->tid, n->name);
+        first = 0;
+    }
+    for (ring = rings; ring != NULL; ring = ring->next)
+        dump_ring(f, ring, pid, &first);
+    safe_unlock(&rings_lock);
+
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0 ? 0 : -1;
+}
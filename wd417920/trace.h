@@ -0,0 +1,54 @@
+// Event tracing into per-thread ring buffers, dumped as a Chrome trace.
+//
+// Every thread records its events into a ring of its own, the oldest events are
+// overwritten once it is full. Only the owner writes to a ring; the dump reads
+// the rings while they are written and drops the events overwritten meanwhile.
+// Rings of exited threads are handed to new threads, with their events, so a
+// dump after a system has been joined still shows its workers; every event
+// carries the thread that recorded it. With CACTI_TRACE set to 0 the helpers
+// are empty and callers compile to nothing.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+
+#include "cacti.h"
+
+#define TRACE_RING_SIZE 8192        ///< events kept per thread, a power of two
+
+#define TRACE_SEND      0           ///< a message has been accepted into a mailbox, arg is its type
+#define TRACE_SCHEDULE  1           ///< an actor has been put on a run queue, arg is 1 if urgent
+#define TRACE_DISPATCH  2           ///< a callback runs, arg is the type of the message
+#define TRACE_SPAWN     3           ///< an actor has been created
+#define TRACE_GODIE     4           ///< an actor has taken MSG_GODIE
+#define TRACE_PARK      5           ///< a worker sleeps
+#define TRACE_EVENTS    6
+
+#define TRACE_INSTANT   'i'
+#define TRACE_BEGIN     'B'
+#define TRACE_END       'E'
+
+extern atomic_int trace_enabled;
+
+extern void trace_record(int event, char phase, long actor, long arg);
+
+/// names the calling thread in the trace
+extern void trace_name_thread(const char *name);
+
+/**
+ * Writes the events of all threads to a file, as JSON of the Chrome trace event format.
+ * @return      0 on success, -1 if the file could not be written
+ */
+extern int trace_dump(const char *path);
+
+static inline void trace(int event, char phase, long actor, long arg) {
+#if CACTI_TRACE
+    if (atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+        trace_record(event, phase, actor, arg);
+#else
+    (void) event, (void) phase, (void) actor, (void) arg;
+#endif
+}
+
+#endif //TRACE_H